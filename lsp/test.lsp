@@ -89,6 +89,7 @@
         (test = (ilog2 1)               0)
         (test = (ilog2 5)               2)
         (test = (ilog2 8)               3)
+        (test = (cdr (car (procedure-environment ((lambda (x) (lambda () x)) 5)))) 5)
         (test = (is-utf8 "∀x∈ℝ: ⌈x⌉ = −⌊−x⌋") t)
         (test = (is-utf8 "α ∧ ¬β = ¬(¬α ∨ β)") t)
         (test = (is-utf8 "ℕ ⊆ ℕ₀ ⊂ ℤ ⊂ ℚ ⊂ ℝ ⊂ ℂ") t)
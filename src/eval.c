@@ -16,21 +16,31 @@
 
 static const int dynamic_on = 0; /**< 0 for lexical scoping, !0 for dynamic scoping*/
 
-/**@brief make new lisp cells and perform garbage bookkeeping/collection*/
-static lisp_cell_t *mk(lisp_t * l, lisp_type type, size_t count, ...) {
+/**@brief allocate a new, zeroed, cell and perform garbage bookkeeping/collection,
+ *	  the cell must be added to the garbage collection stack once it is filled in*/
+static lisp_cell_t *mk_cell(lisp_t * l, lisp_type type, size_t count) {
 	assert(l && type != INVALID && count);
 	lisp_cell_t *ret;
-	gc_list_t *node; /**< new node in linked list of all allocations*/
+
+	if (l->gc_quota)
+		lisp_gc_reserve(l, sizeof(*ret) + (count - 1) * sizeof(ret->p[0]));
+	if (l->gc_heap + l->gc_external >= l->gc_threshold)
+		lisp_gc_collect(l);
+	else if (l->gc_marking && !(++l->gc_collectp % GC_SLICE_PERIOD))
+		lisp_gc_slice(l);
+
+	ret = lisp_gc_alloc(l, count);
+	ret->type = type;
+	return ret;
+}
+
+/**@brief make new lisp cells and perform garbage bookkeeping/collection*/
+static lisp_cell_t *mk(lisp_t * l, lisp_type type, size_t count, ...) {
+	lisp_cell_t *ret = mk_cell(l, type, count);
 	va_list ap;
 	size_t i;
 
-	if (l->gc_collectp++ > COLLECTION_POINT)	/*set to 1 for testing */
-		lisp_gc_mark_and_sweep(l);
-
 	va_start(ap, count);
-	ret  = lisp_calloc(l, sizeof(lisp_cell_t) + (count - 1) * sizeof(cell_data_t));
-	node = lisp_calloc(l, sizeof(*node));
-	ret->type = type;
 	for (i = 0; i < count; i++)
 		if (FLOAT == type)
 			ret->p[i].f = va_arg(ap, double);
@@ -39,9 +49,6 @@ static lisp_cell_t *mk(lisp_t * l, lisp_type type, size_t count, ...) {
 		else
 			ret->p[i].v = va_arg(ap, void *);
 	va_end(ap);
-	node->ref = ret;
-	node->next = l->gc_head;
-	l->gc_head = node;
 	lisp_gc_add(l, ret);
 	return ret;
 }
@@ -64,11 +71,13 @@ lisp_cell_t *cdr(lisp_cell_t * con) {
 void set_car(lisp_cell_t * con, lisp_cell_t * val) {
 	assert(con && is_cons(con) && val);
 	con->p[0].v = val;
+	lisp_gc_write_barrier(con);
 }
 
 void set_cdr(lisp_cell_t * con, lisp_cell_t * val) {
 	assert(con && is_cons(con) && val);
 	con->p[1].v = val;
+	lisp_gc_write_barrier(con);
 }
 
 void close_cell(lisp_cell_t * x) {
@@ -88,22 +97,22 @@ int is_nil(lisp_cell_t * x) {
 
 int is_int(lisp_cell_t * x) {
 	assert(x);
-	return x->type == INTEGER;
+	return cell_type(x) == INTEGER;
 }
 
 int is_floating(lisp_cell_t * x) {
 	assert(x);
-	return x->type == FLOAT;
+	return cell_type(x) == FLOAT;
 }
 
 int is_io(lisp_cell_t * x) {
 	assert(x);
-	return x->type == IO && !x->close;
+	return cell_type(x) == IO && !x->close;
 }
 
 int is_cons(lisp_cell_t * x) {
 	assert(x);
-	return x->type == CONS;
+	return cell_type(x) == CONS;
 }
 
 int is_proper_cons(lisp_cell_t * x) {
@@ -113,42 +122,47 @@ int is_proper_cons(lisp_cell_t * x) {
 
 int is_proc(lisp_cell_t * x) {
 	assert(x);
-	return x->type == PROC;
+	return cell_type(x) == PROC;
 }
 
 int is_fproc(lisp_cell_t * x) {
 	assert(x);
-	return x->type == FPROC;
+	return cell_type(x) == FPROC;
 }
 
 int is_str(lisp_cell_t * x) {
 	assert(x);
-	return x->type == STRING;
+	return cell_type(x) == STRING;
 }
 
 int is_sym(lisp_cell_t * x) {
 	assert(x);
-	return x->type == SYMBOL;
+	return cell_type(x) == SYMBOL;
 }
 
 int is_subr(lisp_cell_t * x) {
 	assert(x);
-	return x->type == SUBR;
+	return cell_type(x) == SUBR;
 }
 
 int is_hash(lisp_cell_t * x) {
 	assert(x);
-	return x->type == HASH;
+	return cell_type(x) == HASH;
 }
 
 int is_userdef(lisp_cell_t * x) {
 	assert(x);
-	return x->type == USERDEF && !x->close;
+	return cell_type(x) == USERDEF && !x->close;
 }
 
 int is_usertype(lisp_cell_t * x, const int type) {
 	assert(x && type < MAX_USER_TYPES && type >= 0);
-	return x->type == USERDEF && get_user_type(x) == type && !x->close;
+	return cell_type(x) == USERDEF && get_user_type(x) == type && !x->close;
+}
+
+int is_weak(lisp_cell_t * x) {
+	assert(x);
+	return cell_type(x) == WEAK;
 }
 
 int is_asciiz(lisp_cell_t * x) {
@@ -168,7 +182,7 @@ int is_func(lisp_cell_t * x) {
 
 int is_closed(lisp_cell_t * x) {
 	assert(x);
-	return x->close;
+	return !is_fixnum(x) && x->close;
 }
 
 int is_list(lisp_cell_t * x) {
@@ -179,14 +193,24 @@ int is_list(lisp_cell_t * x) {
 	return 1;
 }
 
-static lisp_cell_t *mk_asciiz(lisp_t * l, char *s, lisp_type type) {
+/**@brief make a string or symbol, the first field points to the string
+ *	  and the second holds its length. Short strings are copied into the
+ *	  fields after those, in which case "s" is freed if it is "owned",
+ *	  longer ones are used as they are.*/
+static lisp_cell_t *mk_asciiz(lisp_t * l, char *s, lisp_type type, int owned) {
 	assert(l && s && (type == STRING || type == SYMBOL));
-	lisp_cell_t *x = mk(l, type, 2, (lisp_cell_t *) s, strlen(s));
+	const size_t len = strlen(s);
+	if (len > STRING_INLINE_LEN)
+		return mk(l, type, 2, (lisp_cell_t *) s, len);
+	lisp_cell_t *x = mk(l, type, 2 + (len + sizeof(cell_data_t)) / sizeof(cell_data_t), NULL, len, NULL, NULL, NULL);
+	x->p[0].v = memcpy(&x->p[2], s, len + 1);
+	if (owned)
+		free(s);
 	return x;
 }
 
 static lisp_cell_t *mk_sym(lisp_t * l, char *s) {
-	return mk_asciiz(l, s, SYMBOL);
+	return mk_asciiz(l, s, SYMBOL, 1);
 }
 
 lisp_cell_t *mk_list(lisp_t * l, lisp_cell_t * x, ...) {
@@ -203,24 +227,52 @@ lisp_cell_t *mk_list(lisp_t * l, lisp_cell_t * x, ...) {
 
 lisp_cell_t *mk_int(lisp_t * l, const intptr_t d) {
 	assert(l);
+	if (d >= FIXNUM_MIN && d <= FIXNUM_MAX) /*no allocation needed*/
+		return (lisp_cell_t *) (((uintptr_t)d << 1) | FIXNUM_TAG);
 	return mk(l, INTEGER, 1, (lisp_cell_t *) d);
 }
 
 lisp_cell_t *mk_io(lisp_t * l, io_t * x) {
 	assert(l && x);
+	l->gc_owned += sizeof(*x) + (io_is_string(x) ? x->max : 0);
 	return mk(l, IO, 1, (lisp_cell_t *) x);
 }
 
-lisp_cell_t *mk_subr(lisp_t * l, lisp_subr_func p, const char *fmt, const char *doc) {
-	assert(l && p);
-	lisp_cell_t *t = mk(l, SUBR, 4, p, NULL, NULL, NULL);
-	if (fmt) {
-		size_t tlen = lisp_validate_arg_count(fmt);
+/**@brief make a primitive, the caller sets the function it calls*/
+static lisp_cell_t *mk_primitive(lisp_t * l, const char *fmt, const char *doc) {
+	unsigned char codes[SUBR_MAX_ARGS];
+	size_t tlen = 0, fields = SUBR_CODES;
+	lisp_cell_t *d, *t;
+	if (fmt) { /*the format is compiled into the fields after SUBR_CODES*/
+		tlen = lisp_validate_arg_count(fmt);
 		assert((BITS_IN_LENGTH >= 32) && tlen < 0xFFFFFFFFu);
-		t->p[3].v = (void*)tlen;
+		if (tlen > SUBR_MAX_ARGS || lisp_validate_compile(fmt, codes, tlen) < 0)
+			LISP_RECOVER(l, "%r\"invalid validation format\"%t \"%s\"", fmt);
+		fields += (tlen + sizeof(cell_data_t) - 1) / sizeof(cell_data_t);
 	}
+	/*the docstring is made first so "t" is always younger than it*/
+	d = mk_str(l, lisp_strdup(l, doc ? doc : ""));
+	t = mk_cell(l, SUBR, fields);
 	t->p[1].v = (void *)fmt;
-	t->p[2].v = (void *)mk_str(l, lisp_strdup(l, doc ? doc : ""));
+	t->p[2].v = (void *)d;
+	t->p[3].v = (void *)tlen;
+	memcpy(subr_codes(t), codes, tlen);
+	lisp_gc_add(l, t);
+	return t;
+}
+
+lisp_cell_t *mk_subr(lisp_t * l, lisp_subr_func p, const char *fmt, const char *doc) {
+	assert(l && p);
+	lisp_cell_t *t = mk_primitive(l, fmt, doc);
+	t->p[0].prim = p;
+	return t;
+}
+
+lisp_cell_t *mk_subr_vector(lisp_t * l, lisp_subr_vector_func p, const char *fmt, const char *doc) {
+	assert(l && p);
+	lisp_cell_t *t = mk_primitive(l, fmt, doc);
+	t->p[0].vprim = p;
+	t->vector = 1;
 	return t;
 }
 
@@ -241,23 +293,31 @@ lisp_cell_t *mk_float(lisp_t * l, lisp_float_t f) {
 
 /**@todo fix for binary data, also make version that automatically does the string dup*/
 lisp_cell_t *mk_str(lisp_t * l, char *s) {
-	return mk_asciiz(l, s, STRING);
+	return mk_asciiz(l, s, STRING, 1);
 }
 
 lisp_cell_t *mk_immutable_str(lisp_t * l, const char *s) {
-	lisp_cell_t *r = mk_str(l, (char*)s);
+	lisp_cell_t *r = mk_asciiz(l, (char*)s, STRING, 0);
 	r->uncollectable = 1;
 	return r;
 }
 
 lisp_cell_t *mk_hash(lisp_t * l, hash_table_t * h) {
+	if (h)
+		l->gc_owned += sizeof(*h) + h->len * sizeof(*h->table);
 	return mk(l, HASH, 1, (lisp_cell_t *) h);
 }
 
+lisp_cell_t *mk_weak(lisp_t * l, lisp_cell_t * x) {
+	assert(l && x);
+	lisp_cell_t *ret = mk(l, WEAK, 1, x);
+	lisp_gc_weak(l, ret);
+	return ret;
+}
+
 lisp_cell_t *mk_user(lisp_t * l, void *x, const intptr_t type) {
 	assert(l && x && type >= 0 && type < l->user_defined_types_used);
-	lisp_cell_t *ret = mk(l, USERDEF, 2, x);
-	ret->p[1].v = (void *)type;
+	lisp_cell_t *ret = mk(l, USERDEF, 3, x, (void *)type, (void *)0);
 	return ret;
 }
 
@@ -266,7 +326,7 @@ unsigned get_length(lisp_cell_t * x) {
 	assert(x);
 	if (is_nil(x))
 		return 0;
-	switch (x->type) {
+	switch (cell_type(x)) {
 	case STRING:
 	case SYMBOL:
 		return (uintptr_t)(x->p[1].v);
@@ -283,15 +343,17 @@ unsigned get_length(lisp_cell_t * x) {
 
 void *get_raw(lisp_cell_t * x) {
 	assert(x);
-	return x->p[0].v;
+	return is_fixnum(x) ? (void *)get_int(x) : x->p[0].v;
 }
 
 intptr_t get_int(lisp_cell_t * x) {
+	if (is_fixnum(x))
+		return (intptr_t) (uintptr_t) x >> 1;
 	return !x ? 0 : (intptr_t) (x->p[0].v);
 }
 
 lisp_subr_func get_subr(lisp_cell_t * x) {
-	assert(x && is_subr(x));
+	assert(x && is_subr(x) && !x->vector);
 	return x->p[0].prim;
 }
 
@@ -317,11 +379,11 @@ lisp_cell_t *get_func_docstring(lisp_cell_t * x) {
 
 char *get_func_format(lisp_cell_t * x) {
 	assert(x && is_func(x));
-	return is_subr(x) ? x->p[1].v : x->p[3].v;
+	return is_subr(x) ? x->p[1].v : NULL; /*p[3] of a procedure is its bytecode*/
 }
 
 io_t *get_io(lisp_cell_t * x) {
-	assert(x && x->type == IO);
+	assert(x && cell_type(x) == IO);
 	return (io_t *) (x->p[0].v);
 }
 
@@ -336,12 +398,12 @@ char *get_str(lisp_cell_t * x) {
 }
 
 void *get_user(lisp_cell_t * x) {
-	assert(x && x->type == USERDEF);
+	assert(x && cell_type(x) == USERDEF);
 	return (void *)(x->p[0].v);
 }
 
 int get_user_type(lisp_cell_t * x) {
-	assert(x && x->type == USERDEF);
+	assert(x && cell_type(x) == USERDEF);
 	return (intptr_t) x->p[1].v;
 }
 
@@ -350,6 +412,11 @@ hash_table_t *get_hash(lisp_cell_t * x) {
 	return (hash_table_t *) (x->p[0].v);
 }
 
+lisp_cell_t *get_weak(lisp_cell_t * x) {
+	assert(x && is_weak(x));
+	return x->p[0].v;
+}
+
 lisp_float_t get_float(lisp_cell_t * x) {
 	assert(x && is_floating(x));
 	return x->p[0].f;
@@ -389,25 +456,45 @@ lisp_cell_t *lisp_extend(lisp_t * l, lisp_cell_t * env, lisp_cell_t * sym, lisp_
 	return cons(l, cons(l, sym, val), env);
 }
 
+/**@brief make a FRAME binding the first "n" symbols of "syms" to nil in
+ *	  front of "env", see FRAME in private.h*/
+static lisp_cell_t *mk_frame(lisp_t * l, lisp_cell_t * env, lisp_cell_t * syms, size_t n) {
+	assert(l && env && syms && n && n <= FRAME_MAX);
+	lisp_cell_t *ret = mk_cell(l, FRAME, FRAME_VALUES + n);
+	ret->p[0].v = env;
+	ret->p[1].v = syms;
+	ret->p[2].v = (void *)n;
+	for (size_t i = 0; i < n; i++)
+		ret->p[FRAME_VALUES + i].v = l->nil;
+	lisp_gc_add(l, ret);
+	return ret;
+}
+
+lisp_cell_t *lisp_extend_frame(lisp_t * l, lisp_cell_t * env, lisp_cell_t * sym) {
+	return mk_frame(l, env, sym, 1);
+}
+
 lisp_cell_t *lisp_intern(lisp_t * l, char *name) {
 	assert(l && name);
 	lisp_cell_t *op = hash_lookup(get_hash(l->all_symbols), name);
 	if (op)
 		return op;
-	op = mk_sym(l, name);
-	hash_insert(get_hash(l->all_symbols), name, op);
+	op = mk_sym(l, name); /*"name" may have been freed*/
+	hash_insert(get_hash(l->all_symbols), get_sym(op), op);
+	lisp_gc_write_barrier(l->all_symbols);
 	return op;
 }
 
 /**@todo make use of lisp_copy to make closures work */
 lisp_cell_t *lisp_copy(lisp_t *l, lisp_cell_t *src) {
 	assert(l && src);
-	switch (src->type) {
+	switch (cell_type(src)) {
 	case SUBR:
 	case SYMBOL:
+	case VARIABLE:
 		return src; /*symbols, subroutines must be immutable*/
 	case INTEGER:
-		return mk_int(l, get_int(src));
+		return is_fixnum(src) ? src : mk_int(l, get_int(src));
 	case STRING:
 		/**@todo do binary copy, not string copy, also do not copy
 		 * immutable strings*/
@@ -423,14 +510,27 @@ lisp_cell_t *lisp_copy(lisp_t *l, lisp_cell_t *src) {
 	}
 	case FLOAT:
 		return mk_float(l, get_float(src));
+	case WEAK:
+		return mk_weak(l, get_weak(src));
+	case FRAME:
+	{
+		lisp_cell_t *dst = mk_frame(l, lisp_copy(l, frame_parent(src)), frame_symbols(src), frame_count(src));
+		for (size_t i = FRAME_VALUES; i < FRAME_VALUES + frame_count(src); i++)
+			lisp_binding_set(dst, i, lisp_copy(l, binding_value(src, i)));
+		return dst;
+	}
 	case PROC:
 	case FPROC:
-		return mk(l, src->type, 5,
+	{
+		lisp_cell_t *dst = mk(l, src->type, 5,
 				lisp_copy(l, get_proc_args(src)),
 				lisp_copy(l, get_proc_code(src)),
 				lisp_copy(l, get_proc_env(src)),
-				NULL,
+				NULL, /*the copy compiles its own bytecode*/
 				get_func_docstring(src));
+		dst->bytecode = src->bytecode;
+		return dst;
+	}
 	case IO:
 	case USERDEF:
 		LISP_RECOVER(l, "%y'cannot-copy%t\n %S", src);
@@ -445,34 +545,184 @@ lisp_cell_t *lisp_copy(lisp_t *l, lisp_cell_t *src) {
 
 /***************************** environment ************************************/
 
-static lisp_cell_t *function_args(lisp_t * l, lisp_cell_t *proc, lisp_cell_t * vals) {
-	assert(l && proc && vals);
+lisp_cell_t *lisp_function_frame(lisp_t * l, lisp_cell_t * proc, size_t args, size_t argc) {
+	assert(l && proc && args + argc <= l->gc_stack_used);
 	lisp_cell_t *env = dynamic_on ? l->cur_env : get_proc_env(proc);
-       	lisp_cell_t *syms = get_proc_args(proc);
-	size_t i = 0, expect = get_length(get_proc_args(proc));
-	if (!expect)
-		return env;
-	const size_t test = is_sym(syms) ? 0 : 1;
-	for (i = 0; is_cons(syms) && is_cons(vals); syms = cdr(syms), vals = cdr(vals), i++)
-		env = lisp_extend(l, env, car(syms), car(vals));
-	if (!is_nil(syms))
-		env = lisp_extend(l, env, syms, vals);
-	if (test && expect != i)
-		LISP_RECOVER(l, "%y'argument-count-error%t\n %S\n '%S", proc, vals);
+	lisp_cell_t *syms = get_proc_args(proc), *s;
+	size_t n = 0, next = args;
+	for (s = syms; is_cons(s); s = cdr(s))
+		n++;
+	if (n > argc)
+		LISP_RECOVER(l, "%y'argument-count-error%t\n %S\n %d", proc, (intptr_t)argc);
+	if (!is_nil(s))
+		n++; /*the rest of the arguments are bound to a symbol*/
+	while (n) { /*more than FRAME_MAX arguments take more than one FRAME*/
+		const size_t count = n < FRAME_MAX ? n : FRAME_MAX;
+		lisp_cell_t *frame = env = mk_frame(l, env, syms, count);
+		for (size_t i = FRAME_VALUES; i < FRAME_VALUES + count; i++, syms = cdr(syms)) {
+			if (!is_cons(syms)) {
+				lisp_cell_t *rest = l->nil;
+				for (size_t j = args + argc; j > next; j--)
+					rest = cons(l, l->gc_stack[j - 1], rest);
+				lisp_binding_set(frame, i, rest);
+				break;
+			}
+			frame->p[i].v = l->gc_stack[next++];
+		}
+		n -= count;
+	}
 	return env;
 }
 
+lisp_cell_t *lisp_function_args(lisp_t * l, lisp_cell_t *proc, lisp_cell_t * vals) {
+	assert(l && proc && vals);
+	const size_t args = l->gc_stack_used;
+	size_t argc = 0;
+	for (; is_cons(vals); vals = cdr(vals), argc++)
+		lisp_gc_add(l, car(vals));
+	return lisp_function_frame(l, proc, args, argc);
+}
+
+/**@brief call a primitive taking an array of arguments with more of them
+ *	  than lisp_subr_call() has room for on the C stack, the array is
+ *	  freed even if the primitive throws an error*/
+static lisp_cell_t *subr_call_large(lisp_t * l, lisp_cell_t * subr, size_t argc, lisp_cell_t ** argv) {
+	volatile int restore_used = 0;
+	lisp_cell_t *ret;
+	jmp_buf restore;
+	int r;
+	if (l->recover_init) {
+		memcpy(restore, l->recover, sizeof(jmp_buf));
+		restore_used = 1;
+	}
+	if ((r = setjmp(l->recover))) {
+		LISP_RECOVER_RESTORE(restore_used, l, restore);
+		free(argv);
+		lisp_throw(l, r);
+		return l->error;
+	}
+	l->recover_init = 1;
+	lisp_validate_vector(l, subr, argc, argv, 1);
+	ret = (*subr->p[0].vprim) (l, argc, argv);
+	LISP_RECOVER_RESTORE(restore_used, l, restore);
+	free(argv);
+	return ret;
+}
+
+lisp_cell_t *lisp_subr_call(lisp_t * l, lisp_cell_t * subr, size_t args, size_t argc) {
+	assert(l && subr && is_subr(subr) && args + argc <= l->gc_stack_used);
+	lisp_cell_t *argv[SMALL_DEFAULT_LEN], **large, *vals = l->nil;
+	if (!subr->vector) {
+		for (size_t i = args + argc; i > args; i--)
+			vals = cons(l, l->gc_stack[i - 1], vals);
+		lisp_validate_cell(l, subr, vals, 1);
+		return (*get_subr(subr)) (l, vals);
+	}
+	/*the garbage collection stack can move when the primitive allocates,
+	 *so it gets a copy of the arguments, which the stack still keeps alive*/
+	if (argc > SMALL_DEFAULT_LEN) {
+		if (!(large = malloc(argc * sizeof(*large))))
+			lisp_out_of_memory(l);
+		memcpy(large, l->gc_stack + args, argc * sizeof(*large));
+		return subr_call_large(l, subr, argc, large);
+	}
+	memcpy(argv, l->gc_stack + args, argc * sizeof(*argv));
+	lisp_validate_vector(l, subr, argc, argv, 1);
+	return (*subr->p[0].vprim) (l, argc, argv);
+}
+
+lisp_cell_t *lisp_args_list(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	assert(l && (argv || !argc));
+	lisp_cell_t *vals = l->nil;
+	while (argc)
+		vals = cons(l, argv[--argc], vals);
+	return vals;
+}
+
+lisp_cell_t *lisp_eval_body(lisp_t * l, unsigned depth, lisp_cell_t * code, lisp_cell_t * env) {
+	assert(l && code && env);
+	size_t base;
+	lisp_gc_add(l, env);
+	base = l->gc_stack_used;
+	if (is_nil(code))
+		return l->nil;
+	for (; !is_nil(cdr(code)); code = cdr(code)) {
+		l->gc_stack_used = base;
+		(void)eval(l, depth, car(code), env);
+	}
+	l->gc_stack_used = base;
+	return eval(l, depth, car(code), env);
+}
+
 lisp_cell_t *lisp_extend_top(lisp_t * l, lisp_cell_t * sym, lisp_cell_t * val) {
 	assert(l && sym && val);
+	lisp_cell_t *binding = hash_lookup(get_hash(l->top_hash), get_str(sym));
+	if (binding) { /*changed in place, VARIABLEs may refer to it*/
+		set_cdr(binding, val);
+		return val;
+	}
 	if (hash_insert(get_hash(l->top_hash), get_str(sym), cons(l, sym, val)) < 0)
 		lisp_out_of_memory(l);
+	lisp_gc_write_barrier(l->top_hash);
 	return val;
 }
 
+/**@brief the field of the last binding of "key" in a FRAME, or 0 if the
+ *	  FRAME does not bind it*/
+static size_t frame_slot(lisp_cell_t * frame, lisp_cell_t * key) {
+	lisp_cell_t *syms = frame_symbols(frame);
+	size_t i, slot = 0;
+	for (i = FRAME_VALUES; i < FRAME_VALUES + frame_count(frame); i++, syms = cdr(syms)) {
+		if (!is_cons(syms)) {
+			if (syms == key)
+				slot = i;
+			break;
+		}
+		if (car(syms) == key)
+			slot = i;
+	}
+	return slot;
+}
+
+lisp_cell_t *lisp_frame_symbol(lisp_cell_t * frame, size_t i) {
+	assert(frame && is_frame(frame) && i < frame_count(frame));
+	lisp_cell_t *syms = frame_symbols(frame);
+	for (; i; i--)
+		syms = cdr(syms);
+	return is_cons(syms) ? car(syms) : syms;
+}
+
+lisp_cell_t *lisp_env_lookup(lisp_cell_t * key, lisp_cell_t * env, size_t *slot) {
+	assert(key && env && slot);
+	for (; is_cons(env) || is_frame(env); env = env_next(env)) {
+		if (is_frame(env)) {
+			if ((*slot = frame_slot(env, key)))
+				return env;
+			continue;
+		}
+		*slot = 1;
+		if (is_cons(car(env))) {
+			if (get_int(CAAR(env)) == get_int(key))
+				return car(env);
+		} else if (is_hash(car(env)) && is_asciiz(key)) {
+			lisp_cell_t *lookup = hash_lookup(get_hash(car(env)), get_str(key));
+			if (lookup)
+				return lookup;
+		}
+	}
+	return gsym_nil();
+}
+
+void lisp_binding_set(lisp_cell_t * binding, size_t slot, lisp_cell_t * val) {
+	assert(binding && (is_cons(binding) || is_frame(binding)) && val);
+	binding->p[slot].v = val;
+	lisp_gc_write_barrier(binding);
+}
+
 /**@todo an rassoc, that would search for a value and return a key, would be
  *       very useful*/
-lisp_cell_t *lisp_assoc(lisp_cell_t * key, lisp_cell_t * alist) {
-	assert(key && alist);
+lisp_cell_t *lisp_assoc(lisp_t * l, lisp_cell_t * key, lisp_cell_t * alist) {
+	assert(l && key && alist);
 	for (; is_cons(alist); alist = cdr(alist))
 		if (is_cons(car(alist))) {	/*normal assoc */
 			if (get_int(CAAR(alist)) == get_int(key))
@@ -482,6 +732,11 @@ lisp_cell_t *lisp_assoc(lisp_cell_t * key, lisp_cell_t * alist) {
 			if (lookup)
 				return lookup;
 		}
+	if (is_frame(alist)) { /*the rest is an environment*/
+		size_t slot;
+		lisp_cell_t *binding = lisp_env_lookup(key, alist, &slot);
+		return is_frame(binding) ? cons(l, key, binding_value(binding, slot)) : binding;
+	}
 	if (!is_nil(alist)) /* should LISP_RECOVER really*/
 		gsym_error();
 	return gsym_nil();
@@ -489,53 +744,187 @@ lisp_cell_t *lisp_assoc(lisp_cell_t * key, lisp_cell_t * alist) {
 
 /******************************** evaluator ***********************************/
 
-/** @brief "Compile" an expression, that is, perform optimizations
- *         and bind as many variables as possible. This function
- *         is a work in progress.
- *  @bug  This function really, really needs fixing.
- *  @bug  F-Expressions should be prevent compilation of their arguments
+int lisp_is_special(lisp_t * l, lisp_cell_t * x) {
+#define X(CNAME, LNAME, FORM) if (x == l->CNAME) return 1;
+	CELL_XLIST
+#undef X
+	return 0;
+}
+
+static lisp_cell_t *mk_variable(lisp_t * l, lisp_cell_t * sym, intptr_t depth, lisp_cell_t * binding) {
+	return mk(l, VARIABLE, 3, sym, (void *)depth, binding);
+}
+
+lisp_cell_t *lisp_variable_lookup(lisp_t * l, lisp_cell_t * var, lisp_cell_t * env, size_t *slot) {
+	lisp_cell_t *sym = variable_symbol(var), *binding = variable_binding(var), *e = env;
+	intptr_t depth = variable_depth(var);
+	if (depth == VARIABLE_GLOBAL) {
+		*slot = 1;
+		if (!is_nil(binding))
+			return binding;
+		if (!(binding = hash_lookup(get_hash(l->top_hash), get_sym(sym))))
+			return lisp_env_lookup(sym, env, slot);
+		var->p[2].v = binding; /*it has been defined since it was resolved*/
+		lisp_gc_write_barrier(var);
+		return binding;
+	}
+	for (; is_cons(e) || is_frame(e); e = env_next(e)) {
+		if (is_frame(e)) {
+			const size_t n = frame_count(e);
+			if ((size_t)depth >= n) {
+				depth -= n;
+				continue;
+			}
+			if (lisp_frame_symbol(e, n - 1 - depth) != sym)
+				break;
+			*slot = FRAME_VALUES + n - 1 - depth;
+			return e;
+		}
+		if (depth) {
+			depth--;
+			continue;
+		}
+		if (!is_cons(car(e)) || CAAR(e) != sym)
+			break;
+		*slot = 1;
+		return car(e);
+	}
+	return lisp_env_lookup(sym, env, slot);
+}
+
+/** @brief Resolve a symbol to a VARIABLE. "scope" is a list of the symbols
+ *         that will be bound in front of "env" when the code is run, in
+ *         the order the bindings will be found in.**/
+static lisp_cell_t *resolve_symbol(lisp_t * l, lisp_cell_t * sym, lisp_cell_t * scope, lisp_cell_t * env) {
+	intptr_t depth = 0;
+	if (lisp_is_special(l, sym))
+		return sym;
+	for (; is_cons(scope); scope = cdr(scope), depth++)
+		if (car(scope) == sym)
+			return mk_variable(l, sym, depth, l->nil);
+	for (; is_cons(env) || is_frame(env); env = env_next(env), depth++) {
+		if (is_frame(env)) {
+			const size_t slot = frame_slot(env, sym), n = frame_count(env);
+			if (slot)
+				return mk_variable(l, sym, depth + FRAME_VALUES + n - 1 - slot, l->nil);
+			depth += n - 1;
+		} else if (is_cons(car(env))) {
+			if (CAAR(env) == sym)
+				return mk_variable(l, sym, depth, l->nil);
+		} else if (car(env) == l->top_hash) {
+			lisp_cell_t *binding = hash_lookup(get_hash(l->top_hash), get_sym(sym));
+			return mk_variable(l, sym, VARIABLE_GLOBAL, binding ? binding : l->nil);
+		} else {
+			break; /*a hash we do not know will not change*/
+		}
+	}
+	return sym;
+}
+
+/** @brief Add the symbols a procedure call binds to the scope, in the
+ *         same order as lisp_function_args() binds them**/
+static lisp_cell_t *resolve_bind(lisp_t * l, lisp_cell_t * syms, lisp_cell_t * scope) {
+	for (; is_cons(syms); syms = cdr(syms))
+		scope = cons(l, car(syms), scope);
+	if (!is_nil(syms))
+		scope = cons(l, syms, scope);
+	return scope;
+}
+
+static lisp_cell_t *resolve(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * scope, lisp_cell_t * env);
+
+static lisp_cell_t *resolve_list(lisp_t * l, unsigned depth, lisp_cell_t * exps, lisp_cell_t * scope, lisp_cell_t * env) {
+	lisp_cell_t *head = cons(l, l->nil, l->nil), *op = head, *start = exps;
+	for (; is_cons(exps); exps = cdr(exps), op = cdr(op))
+		set_cdr(op, cons(l, resolve(l, depth, car(exps), scope, env), l->nil));
+	if (!is_nil(exps))
+		LISP_RECOVER(l, "%r\"compile cannot eval dotted pairs\"%t\n '%S", start);
+	return cdr(head);
+}
+
+/** @brief "Compile" an expression, a copy of it is made with the variables
+ *         it refers to replaced by VARIABLE cells, so they do not have to
+ *         be searched for by name each time they are evaluated, and which
+ *         is optimized by lisp_optimize() as it is made. Quoted
+ *         data and the arguments of F-Expressions are not changed, nor
+ *         are malformed special forms, which are left for "eval" to
+ *         report.
  *  @todo Add warning about unbound variables
  **/
-static lisp_cell_t *binding_lambda(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * env) {
+static lisp_cell_t *resolve(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * scope, lisp_cell_t * env) {
+	lisp_cell_t *first, *args;
 	if (depth > MAX_RECURSION_DEPTH)
 		LISP_RECOVER(l, "%y'recursion-depth-reached%t %d", depth);
-
-	if (is_sym(exp)) {
-		lisp_cell_t *t = lisp_assoc(exp, env);
-		return !is_nil(t) ? cdr(t) : exp;
+	if (is_sym(exp))
+		return resolve_symbol(l, exp, scope, env);
+	if (!is_cons(exp))
+		return exp;
+	first = car(exp);
+	args = cdr(exp);
+	if (first == l->quote || !is_list(args))
+		return exp;
+	if (first == l->lambda || first == l->flambda || first == l->compile) {
+		lisp_cell_t *rest = args, *code;
+		if (is_cons(rest) && is_str(car(rest))) /*docstring*/
+			rest = cdr(rest);
+		if (!is_cons(rest) || !is_cons(cdr(rest)))
+			return exp;
+		code = cons(l, car(rest), resolve_list(l, depth + 1, cdr(rest), resolve_bind(l, car(rest), scope), env));
+		return cons(l, first, rest == args ? code : cons(l, car(args), code));
 	}
-	lisp_cell_t *op = cons(l, l->nil, l->nil);
-	lisp_cell_t *head = op;
-	for (; is_cons(exp); exp = cdr(exp), op = cdr(op)) {
-		lisp_cell_t *code = car(exp), *t = NULL;
-		if (is_sym(car(exp)) && !is_nil(t = lisp_assoc(car(exp), env)))
-			code = cdr(t);
-		else if (is_cons(car(exp)) && (CAAR(exp) != l->quote))
-			code = binding_lambda(l, depth + 1, car(exp), env);
-		else
-			code = car(exp);
-		set_cdr(op, cons(l, code, l->nil));
+	if (first == l->let) {
+		lisp_cell_t *head = cons(l, l->nil, l->nil), *op = head, *b;
+		for (; is_cons(cdr(args)); args = cdr(args), op = cdr(op)) {
+			if (!is_cons(b = car(args)) || !lisp_check_length(b, 2))
+				return exp;
+			scope = cons(l, car(b), scope); /*see "let" in eval()*/
+			b = mk_list(l, car(b), resolve(l, depth + 1, CADR(b), scope, env), NULL);
+			set_cdr(op, cons(l, b, l->nil));
+		}
+		if (is_nil(args))
+			return exp;
+		set_cdr(op, cons(l, resolve(l, depth + 1, car(args), scope, env), l->nil));
+		return cons(l, first, cdr(head));
 	}
-	if (!is_nil(exp))
-		LISP_RECOVER(l, "%r\"compile cannot eval dotted pairs\"%t\n '%S", head);
-	return cdr(head);
+	if (first == l->cond) {
+		lisp_cell_t *head = cons(l, l->nil, l->nil), *op = head;
+		for (; is_cons(args); args = cdr(args), op = cdr(op))
+			set_cdr(op, cons(l, is_cons(car(args)) ? resolve_list(l, depth + 1, car(args), scope, env) : car(args), l->nil));
+		return lisp_optimize(l, cons(l, first, cdr(head)));
+	}
+	if (first == l->define || first == l->setq) {
+		if (!is_cons(args))
+			return exp;
+		return cons(l, first, cons(l, car(args), resolve_list(l, depth + 1, cdr(args), scope, env)));
+	}
+	first = is_sym(first) ? resolve_symbol(l, first, scope, env) : resolve(l, depth + 1, first, scope, env);
+	if (cell_type(first) == VARIABLE && variable_depth(first) == VARIABLE_GLOBAL
+			&& !is_nil(variable_binding(first)) && is_fproc(cdr(variable_binding(first))))
+		return cons(l, first, args);
+	return lisp_optimize(l, cons(l, first, resolve_list(l, depth + 1, args, scope, env)));
 }
 
-static lisp_cell_t *evlis(lisp_t * l, unsigned depth, lisp_cell_t * exps, lisp_cell_t * env);
+static size_t evargs(lisp_t * l, unsigned depth, lisp_cell_t * exps, lisp_cell_t * env);
 lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * env) {
 	assert(l);
-	size_t gc_stack_save = l->gc_stack_used;
-	lisp_cell_t *tmp, *first, *proc, *ret = NULL, *vals = l->nil;
+	const size_t gc_stack_base = l->gc_stack_used;
+	size_t gc_stack_save;
+	lisp_cell_t *tmp, *first, *proc, *ret = NULL;
+	size_t slot;
 #define DEBUG_RETURN(EXPR) do { ret = (EXPR); goto debug; } while (0);
 	if (!exp || !env)
 		return NULL;
 	if (depth > MAX_RECURSION_DEPTH)
 		LISP_RECOVER(l, "%y'recursion-depth-reached%t %d", 0);
-	lisp_gc_add(l, exp);
-	lisp_gc_add(l, env);
  tail:
 	if (!exp || !env)
 		return NULL;
+	/* "exp" and "env" are kept below the point the GC stack is reset to
+	 * so they stay reachable for as long as this frame uses them */
+	l->gc_stack_used = gc_stack_base;
+	lisp_gc_add(l, exp);
+	lisp_gc_add(l, env);
+	gc_stack_save = l->gc_stack_used;
 	lisp_log_debug(l, "%y'eval%t '%S", exp);
 	if (is_nil(exp))
 		return exp;
@@ -545,7 +934,7 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 		lisp_throw(l, 1);
 	}
 
-	switch (exp->type) {
+	switch (cell_type(exp)) {
 	case INTEGER:
 	case SUBR:
 	case PROC:
@@ -555,13 +944,19 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 	case HASH:
 	case FPROC:
 	case USERDEF:
+	case WEAK:
+	case FRAME:
 		return exp;	/*self evaluating types */
 	case SYMBOL:
 		/* checks could be added here so special forms are not looked
 		 * up, but only if this improves the speed of things*/
-		if (is_nil(tmp = lisp_assoc(exp, env)))
+		if (is_nil(tmp = lisp_env_lookup(exp, env, &slot)))
 			LISP_RECOVER(l, "%r\"unbound symbol\"\n %y'%s%t", get_sym(exp));
-		DEBUG_RETURN(cdr(tmp));
+		DEBUG_RETURN(binding_value(tmp, slot));
+	case VARIABLE:
+		if (is_nil(tmp = lisp_variable_lookup(l, exp, env, &slot)))
+			LISP_RECOVER(l, "%r\"unbound symbol\"\n %y'%s%t", get_sym(variable_symbol(exp)));
+		DEBUG_RETURN(binding_value(tmp, slot));
 	case CONS:
 		first = car(exp);
 		exp = cdr(exp);
@@ -581,12 +976,15 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 			LISP_RECOVER(l, "%y'evaluation\n %r\"cannot eval dotted pair\"%t\n '%S", exp);
 		if (is_cons(first))
 			first = eval(l, depth + 1, first, env);
-		if (first == l->iif) {
+		switch (cell_form(first)) {
+		case FORM_NONE: /*a procedure call*/
+			break;
+		case FORM_IF:
 			LISP_VALIDATE_ARGS(l, "if", 3, "A A A", exp, 1);
 			exp = !is_nil(eval(l, depth + 1, car(exp), env)) ? CADR(exp) : CADDR(exp);
 			goto tail;
-		}
-		if (first == l->lambda) {
+		case FORM_LAMBDA:
+		{
 			lisp_cell_t *doc;
 			if (get_length(exp) < 2)
 				LISP_RECOVER(l, "%y'lambda\n %r\"argc < 2\"%t\n '%S\"", exp);
@@ -600,15 +998,14 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 			tmp = mk_proc(l, car(exp), cdr(exp), env, doc);
 			DEBUG_RETURN(lisp_gc_add(l, tmp));
 		}
-		if (first == l->flambda) {
+		case FORM_FLAMBDA:
 			if (get_length(exp) < 3 || !is_str(car(exp)) || !is_cons(CADR(exp)))
 				LISP_RECOVER(l, "%y'flambda\n %r\"expected (string (arg) code...)\"%t\n '%S", exp);
 			if (!lisp_check_length(CADR(exp), 1) || !is_sym(car(CADR(exp))))
 				LISP_RECOVER(l, "%y'flambda\n %r\"only one symbol argument allowed\"%t\n '%S", exp);
 			l->gc_stack_used = gc_stack_save;
 			DEBUG_RETURN(lisp_gc_add(l, mk_fproc(l, CADR(exp), CDDR(exp), env, car(exp))));
-		}
-		if (first == l->cond) {
+		case FORM_COND:
 			if (lisp_check_length(exp, 0))
 				DEBUG_RETURN(l->nil);
 			for (tmp = l->nil; is_nil(tmp) && !is_nil(exp); exp = cdr(exp)) {
@@ -621,50 +1018,50 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 				}
 			}
 			DEBUG_RETURN(l->nil);
-		}
-		if (first == l->quote)
+		case FORM_QUOTE:
 			DEBUG_RETURN(car(exp));
-		if (first == l->define) {
+		case FORM_DEFINE:
 			LISP_VALIDATE_ARGS(l, "define", 2, "s A", exp, 1);
 			l->gc_stack_used = gc_stack_save;
 			DEBUG_RETURN(lisp_gc_add(l, lisp_extend_top(l, car(exp), eval(l, depth + 1, CADR(exp), env))));
-		}
-		if (first == l->setq) {
-			lisp_cell_t *pair, *newval;
+		case FORM_SETQ:
+		{
+			lisp_cell_t *binding, *newval;
 			LISP_VALIDATE_ARGS(l, "setq", 2, "s A", exp, 1);
-			if (is_nil(pair = lisp_assoc(car(exp), env)))
+			if (is_nil(binding = lisp_env_lookup(car(exp), env, &slot)))
 				LISP_RECOVER(l, "%y'setq\n %r\"undefined variable\"%t\n '%S", exp);
 			newval = eval(l, depth + 1, CADR(exp), env);
-			set_cdr(pair, newval);
+			lisp_binding_set(binding, slot, newval);
 			DEBUG_RETURN(newval);
 		}
-		if (first == l->compile) {
+		case FORM_COMPILE:
+		{
 			lisp_cell_t *doc;
 			LISP_VALIDATE_ARGS(l, "compile", 3, "Z L A", exp, 1);
 			doc = car(exp);
 			for (tmp = CADR(exp); !is_nil(tmp); tmp = cdr(tmp))
 				if (!is_sym(car(tmp)) || !is_proper_cons(tmp))
 					LISP_RECOVER(l, "%y'lambda\n %r\"expected only symbols (or nil) as arguments\"%t\n %S", exp);
-				else
-					env = lisp_extend(l, env, car(tmp), car(tmp));
-			tmp = binding_lambda(l, depth + 1, CADDR(exp), env);
-			DEBUG_RETURN(mk_proc(l, CADR(exp), cons(l, tmp, l->nil), env, doc));
+			tmp = resolve(l, depth + 1, CADDR(exp), resolve_bind(l, CADR(exp), l->nil), env);
+			tmp = mk_proc(l, CADR(exp), cons(l, tmp, l->nil), env, doc);
+			tmp->bytecode = 1;
+			DEBUG_RETURN(tmp);
 		}
-		if (first == l->let) {
-			lisp_cell_t *r = NULL, *s = NULL;
+		case FORM_LET:
+		{
 			if (get_length(exp) < 2)
 				LISP_RECOVER(l, "%y'let\n %r\"argc < 2\"%t\n '%S", exp);
 			tmp = exp;
 			for (; !is_nil(cdr(exp)); exp = cdr(exp)) {
 				if (!is_cons(car(exp)) || !lisp_check_length(car(exp), 2))
 					LISP_RECOVER(l, "%y'let\n %r\"expected list of length 2\"%t\n '%S\n '%S", car(exp), tmp);
-				s = env = lisp_extend(l, env, CAAR(exp), l->nil);
-				r = env = lisp_extend(l, env, CAAR(exp), eval(l, depth + 1, CADAR(exp), env));
-				set_cdr(car(s), CDAR(r));
+				env = lisp_extend_frame(l, env, CAAR(exp));
+				lisp_binding_set(env, FRAME_VALUES, eval(l, depth + 1, CADAR(exp), env));
 			}
 			DEBUG_RETURN(eval(l, depth + 1, car(exp), env));
 		}
-		if (first == l->progn) {
+		case FORM_PROGN:
+		{
 			lisp_cell_t *head = exp;
 			if (is_nil(exp))
 				DEBUG_RETURN(l->nil);
@@ -675,8 +1072,8 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 			exp = car(exp);
 			goto tail;
 		}
-
-		if (first == l->dowhile) {
+		case FORM_WHILE:
+		{
 			lisp_cell_t *wh = car(exp), *head = cdr(exp);
 			while (!is_nil(eval(l, depth + 1, wh, env))) {
 				l->gc_stack_used = gc_stack_save;
@@ -687,35 +1084,50 @@ lisp_cell_t *eval(lisp_t * l, unsigned depth, lisp_cell_t * exp, lisp_cell_t * e
 			}
 			DEBUG_RETURN(l->nil);
 		}
-
-		if (first == l->macro) {
+		case FORM_MACRO:
 			/**@todo implement me*/
+			break;
 		}
 
 		proc = eval(l, depth + 1, first, env);
-		if (is_proc(proc) || is_subr(proc)) /*eval their args */
-			vals = evlis(l, depth + 1, exp, env);
-		else if (is_fproc(proc)) /*f-expr do not eval their args */
-			vals = cons(l, exp, l->nil);
-		else
+		l->gc_stack_used = gc_stack_save;
+		lisp_gc_add(l, proc);
+		if (is_proc(proc)) { /*arguments are evaluated onto the stack*/
+			const size_t args = l->gc_stack_used, argc = evargs(l, depth + 1, exp, env);
+			l->cur_depth = depth;	/*tucked away for function use */
+			l->cur_env = env;	/*also tucked away */
+			env = lisp_function_frame(l, proc, args, argc);
+		} else if (is_subr(proc)) {
+			const size_t args = l->gc_stack_used, argc = evargs(l, depth + 1, exp, env);
+			if (argc == 2 && (tmp = lisp_arith(l, proc, l->gc_stack[args], l->gc_stack[args + 1])))
+				DEBUG_RETURN(tmp);
+			l->cur_depth = depth;
+			l->cur_env = env;
+			DEBUG_RETURN(lisp_subr_call(l, proc, args, argc));
+		} else if (is_fproc(proc)) { /*f-expr do not eval their args */
+			l->cur_depth = depth;
+			l->cur_env = env;
+			env = lisp_function_args(l, proc, cons(l, exp, l->nil));
+		} else {
 			LISP_RECOVER(l, "%r\"not a procedure\"%t\n '%S", first);
-		l->cur_depth = depth;	/*tucked away for function use */
-		l->cur_env = env;	/*also tucked away */
-		if (is_subr(proc)) {
+		}
+		if (proc->bytecode) {
 			l->gc_stack_used = gc_stack_save;
-			lisp_gc_add(l, proc);
-			lisp_gc_add(l, vals);
-			lisp_validate_cell(l, proc, vals, 1);
-			DEBUG_RETURN((*get_subr(proc)) (l, vals));
+			DEBUG_RETURN(lisp_vm_run(l, depth + 1, proc, env));
 		}
-		if (is_proc(proc) || is_fproc(proc)) {
-			env = function_args(l, proc, vals);
-			exp = cons(l, l->progn, get_proc_code(proc));
-			goto tail;
+		/*the code is evaluated in place, as "progn" evaluates it*/
+		l->gc_stack_used = gc_stack_save;
+		lisp_gc_add(l, proc);
+		lisp_gc_add(l, env);
+		gc_stack_save = l->gc_stack_used;
+		if (is_nil(tmp = get_proc_code(proc)))
+			DEBUG_RETURN(l->nil);
+		for (; !is_nil(cdr(tmp)); tmp = cdr(tmp)) {
+			l->gc_stack_used = gc_stack_save;
+			(void)eval(l, depth + 1, car(tmp), env);
 		}
-		LISP_RECOVER(l, "%r\"not a procedure\"%t\n '%S", first);
-		assert(0);
-		break;
+		exp = car(tmp);
+		goto tail;
 	case INVALID:
 	default:
 		FATAL("internal inconsistency: unknown type");
@@ -727,20 +1139,22 @@ debug:
 #undef DEBUG_RETURN
 }
 
-/**< evaluate a list*/
-static lisp_cell_t *evlis(lisp_t * l, unsigned depth, lisp_cell_t * exps, lisp_cell_t * env) {
-	lisp_cell_t *start = exps;
+/**< evaluate a list of arguments onto the garbage collection stack, which
+ *   is the argument stack for procedure and primitive calls, returning how
+ *   many there are*/
+static size_t evargs(lisp_t * l, unsigned depth, lisp_cell_t * exps, lisp_cell_t * env) {
 	assert(l && exps && env);
-	if (is_nil(exps))
-		return exps;
-	lisp_cell_t *op = car(exps);
-	exps = cdr(exps);
-	op = cons(l, eval(l, depth + 1, op, env), l->nil);
-	lisp_cell_t *head = op;
-	for (size_t i = 1; is_cons(exps); exps = cdr(exps), op = cdr(op), i++)
-		set_cdr(op, cons(l, eval(l, depth + 1, car(exps), env), l->nil));
+	const size_t args = l->gc_stack_used;
+	lisp_cell_t *start = exps, *x;
+	size_t argc = 0;
+	for (; is_cons(exps); exps = cdr(exps), argc++) {
+		x = eval(l, depth + 1, car(exps), env);
+		l->gc_stack_used = args + argc;
+		lisp_gc_add(l, x);
+	}
 	if (!is_nil(exps))
 		LISP_RECOVER(l, "%r\"evlis cannot eval dotted pairs\"%t\n '%S", start);
-	return head;
+	return argc;
 }
 
+
@@ -4,71 +4,316 @@
  *  @license    LGPL v2.1 or Later
  *  @email      howe.r.j.89@gmail.com*/
 
+#define _POSIX_C_SOURCE 200112L /* for posix_memalign */
 #include "liblisp.h"
 #include "private.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef USE_THREADS
+#ifndef __unix__
+#error "USE_THREADS not supported on this platform"
+#endif
+#ifndef __GNUC__
+#error "USE_THREADS requires GCC style atomic builtins"
+#endif
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 void lisp_gc_used(lisp_cell_t *x) {
 	assert(x);
-	x->used = 1;
+	if (!is_fixnum(x))
+		x->used = 1;
 }
 
 void lisp_gc_not_used(lisp_cell_t *x) {
 	assert(x);
-	x->used = 0;
+	if (!is_fixnum(x))
+		x->used = 0;
+}
+
+/**@brief number of fields held by the cells in each size class*/
+static const size_t gc_class_fields[GC_SIZE_CLASSES] = { 1, 2, 4, 5, 8, GC_MAX_FIELDS };
+
+enum gc_page_state {
+	GC_PAGE_SWEPT,   /**< the allocator can use the page*/
+	GC_PAGE_UNSWEPT, /**< dead cells have not been freed yet*/
+	GC_PAGE_SWEEPING /**< a thread is sweeping the page*/
+};
+
+static void gc_sweep_page(lisp_t *l, gc_page_t *p);
+static void gc_sweeper_stop(lisp_t *l);
+static size_t gc_owned_bytes(lisp_cell_t *x);
+
+#ifdef USE_THREADS
+#define gc_page_state(P)        __atomic_load_n(&(P)->swept, __ATOMIC_ACQUIRE)
+#define gc_page_set_state(P, S) __atomic_store_n(&(P)->swept, (S), __ATOMIC_RELEASE)
+
+/**@brief take an unswept page to sweep it, it might be taken by another thread
+ * @return int non zero if the page is ours*/
+static int gc_page_claim(gc_page_t *p) {
+	int unswept = GC_PAGE_UNSWEPT;
+	return __atomic_compare_exchange_n(&p->swept, &unswept, GC_PAGE_SWEEPING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#else
+#define gc_page_state(P)        ((P)->swept)
+#define gc_page_set_state(P, S) ((P)->swept = (S))
+
+static int gc_page_claim(gc_page_t *p) {
+	if (p->swept != GC_PAGE_UNSWEPT)
+		return 0;
+	p->swept = GC_PAGE_SWEEPING;
+	return 1;
+}
+#endif
+
+static size_t gc_size_class(size_t count) {
+	assert(count && count <= gc_class_fields[GC_SIZE_CLASSES - 1]);
+	size_t i = 0;
+	while (gc_class_fields[i] < count)
+		i++;
+	return i;
+}
+
+static lisp_cell_t *gc_page_cell(gc_page_t *p, size_t i) {
+	assert(p && i < p->cells);
+	return (lisp_cell_t*)((char*)(p + 1) + i * p->cell_size);
+}
+
+static void gc_release_cell(gc_page_t *p, lisp_cell_t *x) {
+	assert(p && x);
+	x->type = INVALID;
+	x->visit = x->uncollectable = x->close = x->used = 0;
+	x->p[0].v = p->free;
+	p->free = x;
+}
+
+static gc_page_t *gc_page_of(lisp_cell_t *x) {
+	assert(x && !is_fixnum(x) && !x->uncollectable);
+	return (gc_page_t*)((uintptr_t)x & ~(uintptr_t)(GC_PAGE_SIZE - 1));
+}
+
+static size_t gc_bit(lisp_cell_t *x) {
+	return ((uintptr_t)x & (GC_PAGE_SIZE - 1)) / GC_GRAIN;
+}
+
+static int gc_test_bit(const uint64_t *map, lisp_cell_t *x) {
+	const size_t bit = gc_bit(x);
+	return !!(map[bit / 64] & ((uint64_t)1 << (bit % 64)));
+}
+
+static void gc_set_bit(uint64_t *map, lisp_cell_t *x) {
+	const size_t bit = gc_bit(x);
+	map[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+static void gc_clear_bit(uint64_t *map, lisp_cell_t *x) {
+	const size_t bit = gc_bit(x);
+	map[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+/**@brief set the mark bit for a cell
+ * @return int non zero if the cell was already marked*/
+static int gc_set_mark(lisp_cell_t *x) {
+	gc_page_t *p = gc_page_of(x);
+	if (gc_test_bit(p->marks, x))
+		return 1;
+	gc_set_bit(p->marks, x);
+	return 0;
+}
+
+static size_t gc_popcount(uint64_t x) {
+#ifdef __GNUC__
+	return __builtin_popcountll(x);
+#else
+	size_t r = 0;
+	for (; x; x &= x - 1)
+		r++;
+	return r;
+#endif
+}
+
+static void *gc_page_allocate(void) {
+#ifdef _WIN32
+	return _aligned_malloc(GC_PAGE_SIZE, GC_PAGE_SIZE);
+#else
+	void *r = NULL;
+	return posix_memalign(&r, GC_PAGE_SIZE, GC_PAGE_SIZE) ? NULL : r;
+#endif
+}
+
+static void gc_page_deallocate(gc_page_t *p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+static gc_page_t *gc_new_page(lisp_t *l, size_t class) {
+	assert(l && class < GC_SIZE_CLASSES);
+	gc_page_t *p = gc_page_allocate();
+	if (!p)
+		lisp_out_of_memory(l);
+	for (size_t i = 0; i < GC_MARK_WORDS; i++)
+		p->marks[i] = p->remembered[i] = 0;
+	p->cell_size = sizeof(lisp_cell_t) + (gc_class_fields[class] - 1) * sizeof(cell_data_t);
+	p->cells = (GC_PAGE_SIZE - sizeof(*p)) / p->cell_size;
+	p->used = p->bump = 0;
+	p->dirty = 0;
+	p->external = 0;
+	p->swept = GC_PAGE_SWEPT;
+	p->free = NULL;
+	p->next = l->gc_pages[class];
+	l->gc_pages[class] = p;
+	l->gc_page_count++;
+	return p;
 }
 
-static void gc_free(lisp_t * l, lisp_cell_t * x) {
+lisp_cell_t *lisp_gc_alloc(lisp_t *l, size_t count) {
 	assert(l);
-        /*assert(op) *//**< free a lisp cell*/
-	if (!x || x->uncollectable || x->used)
-		return;
+	const size_t class = gc_size_class(count);
+	gc_page_t *p = l->gc_cursor[class];
+	lisp_cell_t *x;
+	for (; p; p = p->next) {
+		while (gc_page_state(p) != GC_PAGE_SWEPT) {
+			if (gc_page_claim(p)) { /*else the sweeper thread has it*/
+				gc_sweep_page(l, p);
+				gc_page_set_state(p, GC_PAGE_SWEPT);
+			}
+		}
+		if (p->free || p->bump < p->cells)
+			break;
+	}
+	if (!p)
+		p = gc_new_page(l, class);
+	l->gc_cursor[class] = p;
+	if (p->free) {
+		x = p->free;
+		p->free = x->p[0].v;
+	} else { /*fresh cells at the end of a page are bump allocated*/
+		x = gc_page_cell(p, p->bump++);
+	}
+	p->used++;
+	l->gc_allocations++;
+	l->gc_heap += p->cell_size;
+	memset(x, 0, p->cell_size);
+	return x;
+}
+
+void lisp_gc_release(lisp_t *l) {
+	assert(l);
+	gc_sweeper_stop(l);
+	for (size_t i = 0; i < GC_SIZE_CLASSES; i++) {
+		for (gc_page_t *p = l->gc_pages[i], *n = NULL; p; p = n) {
+			n = p->next;
+			gc_page_deallocate(p);
+		}
+		l->gc_pages[i] = l->gc_cursor[i] = NULL;
+	}
+	l->gc_page_count = 0;
+	free(l->gc_gray);
+	l->gc_gray = NULL;
+	l->gc_gray_used = l->gc_gray_allocated = 0;
+	free(l->gc_weak);
+	l->gc_weak = NULL;
+	l->gc_weak_used = l->gc_weak_allocated = 0;
+}
+
+/**@brief is the string of a STRING or SYMBOL held in the cell itself?*/
+static int gc_inline_string(lisp_cell_t *x) {
+	return get_str(x) == (char*)&x->p[2];
+}
+
+/**@brief release the resources held by a cell that is no longer reachable,
+ *	  the cell itself belongs to its page and is reused by the allocator
+ * @return int non zero if the cell can be put back onto the free list*/
+static int gc_free(lisp_t * l, lisp_cell_t * x) {
+	assert(l && x);
+	if (x->uncollectable || x->used)
+		return 0;
 	switch (x->type) {
 	case INTEGER:
 	case CONS:
 	case FLOAT:
-	case PROC:
 	case SUBR:
 	case FPROC:
-		free(x);
+	case WEAK:
+	case VARIABLE:
+	case FRAME:
 		break;
-	case STRING:
-		free(get_str(x));
-		free(x);
+	case PROC:
+		free(x->p[3].v); /*bytecode, see vm.c*/
 		break;
+	case STRING:
 	case SYMBOL:
-		free(get_sym(x));
-		free(x);
+		if (!gc_inline_string(x))
+			free(get_str(x));
 		break;
 	case IO:
 		if (!x->close)
 			io_close(get_io(x));
-		free(x);
 		break;
 	case HASH:
 		hash_destroy(get_hash(x));
-		free(x);
 		break;
 	case USERDEF:
 		if (l->ufuncs[get_user_type(x)].free)
 			(l->ufuncs[get_user_type(x)].free) (x);
-		else
-			free(x);
+		lisp_gc_account_external(l, x, 0);
 		break;
 	case INVALID:
 	default:
 		FATAL("internal inconsistency");
 		break;
 	}
+	return 1;
 }
 
-void lisp_gc_mark(lisp_t * l, lisp_cell_t * op) {
+/**@brief put a marked cell on the mark stack (also known as the gray
+ *	  list) so its children will be marked by gc_drain(). If the stack
+ *	  cannot grow the cell is left marked but unscanned and the heap
+ *	  is rescanned for such cells once the stack is empty.*/
+static void gc_push(lisp_t *l, lisp_cell_t *op) {
+	assert(l && op);
+	if (l->gc_gray_used >= l->gc_gray_allocated) {
+		size_t n = l->gc_gray_allocated ? l->gc_gray_allocated * 2 : DEFAULT_LEN;
+		lisp_cell_t **g;
+		if (l->gc_gray_max && n > l->gc_gray_max)
+			n = l->gc_gray_max;
+		g = n > l->gc_gray_allocated ? realloc(l->gc_gray, n * sizeof(*l->gc_gray)) : NULL;
+		if (!g) {
+			l->gc_gray_overflow = 1;
+			return;
+		}
+		l->gc_gray = g;
+		l->gc_gray_allocated = n;
+	}
+	l->gc_gray[l->gc_gray_used++] = op;
+}
+
+/**@brief mark a cell and put it on the mark stack if it was not marked*/
+static void gc_shade(lisp_t *l, lisp_cell_t *op) {
 	assert(l);
-        /*assert(op); *//**<recursively mark reachable cells*/
-	if (!op || op->mark)
+	if (!op || is_fixnum(op) || op->uncollectable || gc_set_mark(op))
 		return;
-	op->mark = 1;
+	gc_push(l, op);
+}
+
+/**@brief shade the children of a marked cell, lists are followed along
+ *	  their cdr in a loop instead of pushing every cons cell, at most
+ *	  "limit" cells of a list are followed (zero for no limit) before
+ *	  the rest of it is pushed back onto the mark stack
+ * @return size_t the number of cells scanned*/
+static size_t gc_mark_children(lisp_t *l, lisp_cell_t *op, size_t limit) {
+	assert(l && op);
+	size_t n = 1;
 	switch (op->type) {
 	case INTEGER:
 	case SYMBOL:
@@ -77,29 +322,57 @@ void lisp_gc_mark(lisp_t * l, lisp_cell_t * op) {
 	case FLOAT:
 		break;
 	case SUBR:
-		lisp_gc_mark(l, get_func_docstring(op));
+		gc_shade(l, get_func_docstring(op));
 		break;
 	case FPROC:
 	case PROC:
-		lisp_gc_mark(l, get_proc_args(op));
-		lisp_gc_mark(l, get_proc_code(op));
-		lisp_gc_mark(l, get_proc_env(op));
-		lisp_gc_mark(l, get_func_docstring(op));
+		gc_shade(l, get_proc_args(op));
+		gc_shade(l, get_proc_code(op));
+		gc_shade(l, get_proc_env(op));
+		gc_shade(l, get_func_docstring(op));
 		break;
 	case CONS:
-		lisp_gc_mark(l, car(op));
-		lisp_gc_mark(l, cdr(op));
+		for (;; n++) {
+			lisp_cell_t *next = cdr(op);
+			gc_shade(l, car(op));
+			if (!is_cons(next) || next->uncollectable || gc_set_mark(next)) {
+				gc_shade(l, next);
+				break;
+			}
+			if (limit && n >= limit) {
+				gc_push(l, next);
+				break;
+			}
+			op = next;
+		}
 		break;
 	case HASH:{
 			size_t i;
 			hash_entry_t *cur;
 			hash_table_t *h = get_hash(op);
-			for (i = 0; i < h->len; i++)
+			for (i = 0; h && i < h->len; i++)
 				if (h->table[i])
-					for (cur = h->table[i]; cur; cur = cur->next)
-						lisp_gc_mark(l, cur->val);
+					for (cur = h->table[i]; cur; cur = cur->next) {
+						lisp_cell_t *x = cur->val;
+						if (!op->weak_keys && !op->weak_values)
+							gc_shade(l, x);
+						else if (is_cons(x)) /*the pair is marked after gc_clear_weak()*/
+							gc_shade(l, op->weak_keys ? NULL : car(x)), gc_shade(l, op->weak_values ? NULL : cdr(x));
+					}
 		}
 		break;
+	case WEAK:
+		break;
+	case VARIABLE:
+		gc_shade(l, variable_symbol(op));
+		gc_shade(l, variable_binding(op));
+		break;
+	case FRAME:
+		gc_shade(l, frame_parent(op));
+		gc_shade(l, frame_symbols(op));
+		for (size_t i = FRAME_VALUES; i < FRAME_VALUES + frame_count(op); i++)
+			gc_shade(l, binding_value(op, i));
+		break;
 	case USERDEF:
 		if (l->ufuncs[get_user_type(op)].mark)
 			(l->ufuncs[get_user_type(op)].mark) (op);
@@ -108,25 +381,548 @@ void lisp_gc_mark(lisp_t * l, lisp_cell_t * op) {
 	default:
 		FATAL("internal inconsistency: unknown type");
 	}
+	return n;
 }
 
-void lisp_gc_sweep_only(lisp_t * l) {
+/**@brief after the mark stack has overflowed any marked cell might not
+ *	  have had its children marked, so all of them are scanned again*/
+static void gc_rescan(lisp_t *l) {
 	assert(l);
-	if (l->gc_off)
+	l->gc_gray_overflow = 0;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next)
+			for (size_t i = 0; i < p->bump; i++) {
+				lisp_cell_t *x = gc_page_cell(p, i);
+				if (gc_test_bit(p->marks, x) && x->type != INVALID)
+					gc_mark_children(l, x, 0);
+			}
+}
+
+/**@brief mark the children of cells on the mark stack until there are no
+ *	  more or the budget has run out, a budget of zero is unlimited
+ * @return int non zero if there is no more marking to do*/
+static int gc_drain(lisp_t *l, size_t cells, unsigned long usecs) {
+	assert(l);
+	const clock_t start = usecs ? clock() : 0;
+	size_t work = 0, slices = 0;
+	for (;;) {
+		while (l->gc_gray_used) {
+			lisp_cell_t *op = l->gc_gray[--l->gc_gray_used];
+			work += gc_mark_children(l, op, cells ? cells : usecs ? 64 : 0);
+			if (cells && work >= cells)
+				return 0;
+			if (usecs && !(++slices % 64) && (unsigned long)(((double)(clock() - start) * 1000000.0) / CLOCKS_PER_SEC) >= usecs)
+				return 0;
+		}
+		if (!l->gc_gray_overflow)
+			return 1;
+		gc_rescan(l);
+	}
+}
+
+void lisp_gc_mark(lisp_t * l, lisp_cell_t * op) {
+	assert(l);
+	gc_sweeper_stop(l);
+	gc_shade(l, op);
+	gc_drain(l, 0, 0);
+}
+
+#ifdef USE_THREADS
+/* Parallel marking: the gray list is split between a number of threads,
+ * each of which marks from a private stack. When other threads are idle
+ * a thread shares some of its work by moving it to a queue that the idle
+ * threads steal from. Mark bits are set with atomic operations, nothing
+ * else is written to during marking, and large hash tables are split up
+ * into ranges of bins that are marked separately. Marking is finished
+ * when every thread is idle, which can only happen when no work is left
+ * in any queue as a thread checks them all before becoming idle.*/
+
+typedef struct {
+	lisp_cell_t *x;  /**< marked cell whose children need marking*/
+	size_t from, to; /**< range of hash bins to mark, if "to" is not zero*/
+} gc_work_t;
+
+typedef struct {
+	gc_work_t *work; /**< stack of work*/
+	size_t used, allocated;
+} gc_work_stack_t;
+
+typedef struct gc_parallel gc_parallel_t;
+
+typedef struct {
+	gc_parallel_t *par;
+	gc_work_stack_t local,  /**< work only this thread uses*/
+			shared; /**< work other threads can steal, guarded by "lock"*/
+	pthread_mutex_t lock;
+	pthread_t thread;
+	int started; /**< is "thread" running?*/
+} gc_marker_t;
+
+struct gc_parallel {
+	lisp_t *l;
+	gc_marker_t *markers;
+	unsigned count,   /**< number of markers*/
+		 running, /**< number of markers that are marking*/
+		 idle;    /**< number of markers that have run out of work*/
+	int go,           /**< set when markers can start*/
+	    overflow;     /**< set if a work stack could not grow*/
+	pthread_mutex_t user; /**< user defined mark functions are not thread safe*/
+};
+
+static int gc_set_mark_atomic(lisp_cell_t *x) {
+	gc_page_t *p = gc_page_of(x);
+	const size_t bit = gc_bit(x);
+	const uint64_t mask = (uint64_t)1 << (bit % 64);
+	if (__atomic_load_n(&p->marks[bit / 64], __ATOMIC_RELAXED) & mask)
+		return 1;
+	return !!(__atomic_fetch_or(&p->marks[bit / 64], mask, __ATOMIC_RELAXED) & mask);
+}
+
+/**@brief push work, if the stack cannot grow the work is dropped and the
+ *	  heap is rescanned after marking, as with gc_push()*/
+static void gc_work_push(gc_parallel_t *par, gc_work_stack_t *s, gc_work_t w) {
+	assert(par && s);
+	if (s->used >= s->allocated) {
+		size_t n = s->allocated ? s->allocated * 2 : DEFAULT_LEN;
+		gc_work_t *g = n > s->allocated ? realloc(s->work, n * sizeof(*s->work)) : NULL;
+		if (!g) {
+			__atomic_store_n(&par->overflow, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		s->work = g;
+		s->allocated = n;
+	}
+	s->work[s->used] = w;
+	__atomic_store_n(&s->used, s->used + 1, __ATOMIC_RELAXED);
+}
+
+static void gc_par_shade(gc_marker_t *m, lisp_cell_t *op) {
+	assert(m);
+	gc_work_t w = { op, 0, 0 };
+	if (!op || is_fixnum(op) || op->uncollectable || gc_set_mark_atomic(op))
 		return;
-	for (gc_list_t **p = &l->gc_head; *p != NULL;) {
-		gc_list_t *v = *p;
-		if (v->ref->mark) {
-			p = &v->next;
-			v->ref->mark = 0;
-		} else {
-			*p = v->next;
-			gc_free(l, v->ref);
-			free(v);
+	gc_work_push(m->par, &m->local, w);
+}
+
+static void gc_par_mark_children(lisp_t *l, gc_marker_t *m, gc_work_t w) {
+	assert(l && m && w.x);
+	lisp_cell_t *op = w.x;
+	switch (op->type) {
+	case INTEGER:
+	case SYMBOL:
+	case STRING:
+	case IO:
+	case FLOAT:
+		break;
+	case SUBR:
+		gc_par_shade(m, get_func_docstring(op));
+		break;
+	case FPROC:
+	case PROC:
+		gc_par_shade(m, get_proc_args(op));
+		gc_par_shade(m, get_proc_code(op));
+		gc_par_shade(m, get_proc_env(op));
+		gc_par_shade(m, get_func_docstring(op));
+		break;
+	case CONS:
+		for (;;) {
+			lisp_cell_t *next = cdr(op);
+			gc_par_shade(m, car(op));
+			if (!is_cons(next) || next->uncollectable || gc_set_mark_atomic(next)) {
+				gc_par_shade(m, next);
+				break;
+			}
+			op = next;
+		}
+		break;
+	case HASH:{
+			hash_table_t *h = get_hash(op);
+			if (!h)
+				break;
+			if (!w.to && h->len > GC_HASH_CHUNK) {
+				for (size_t i = 0; i < h->len; i += GC_HASH_CHUNK) {
+					gc_work_t range = { op, i, i + GC_HASH_CHUNK < h->len ? i + GC_HASH_CHUNK : h->len };
+					gc_work_push(m->par, &m->local, range);
+				}
+				break;
+			}
+			for (size_t i = w.to ? w.from : 0; i < (w.to ? w.to : h->len); i++)
+				for (hash_entry_t *cur = h->table[i]; cur; cur = cur->next) {
+					lisp_cell_t *x = cur->val;
+					if (!op->weak_keys && !op->weak_values)
+						gc_par_shade(m, x);
+					else if (is_cons(x))
+						gc_par_shade(m, op->weak_keys ? NULL : car(x)), gc_par_shade(m, op->weak_values ? NULL : cdr(x));
+				}
+		}
+		break;
+	case WEAK:
+		break;
+	case VARIABLE:
+		gc_par_shade(m, variable_symbol(op));
+		gc_par_shade(m, variable_binding(op));
+		break;
+	case FRAME:
+		gc_par_shade(m, frame_parent(op));
+		gc_par_shade(m, frame_symbols(op));
+		for (size_t i = FRAME_VALUES; i < FRAME_VALUES + frame_count(op); i++)
+			gc_par_shade(m, binding_value(op, i));
+		break;
+	case USERDEF:
+		if (l->ufuncs[get_user_type(op)].mark) {
+			pthread_mutex_lock(&m->par->user);
+			(l->ufuncs[get_user_type(op)].mark) (op);
+			pthread_mutex_unlock(&m->par->user);
+		}
+		break;
+	case INVALID:
+	default:
+		FATAL("internal inconsistency: unknown type");
+	}
+}
+
+/**@brief move work from the top of one stack to another*/
+static size_t gc_work_move(gc_parallel_t *par, gc_work_stack_t *to, gc_work_stack_t *from, size_t n) {
+	assert(par && to && from);
+	size_t i;
+	for (i = 0; i < n && from->used; i++) {
+		gc_work_push(par, to, from->work[from->used - 1]);
+		__atomic_store_n(&from->used, from->used - 1, __ATOMIC_RELAXED);
+	}
+	return i;
+}
+
+/**@brief take half of the shared work of the first marker that has any,
+ *	  starting with the marker "m" itself*/
+static int gc_par_steal(gc_parallel_t *par, gc_marker_t *m) {
+	assert(par && m);
+	const size_t self = m - par->markers;
+	for (size_t i = 0; i < par->count; i++) {
+		gc_marker_t *v = &par->markers[(self + i) % par->count];
+		size_t moved;
+		if (!__atomic_load_n(&v->shared.used, __ATOMIC_RELAXED))
+			continue;
+		pthread_mutex_lock(&v->lock);
+		moved = gc_work_move(par, &m->local, &v->shared, (v->shared.used + 1) / 2);
+		pthread_mutex_unlock(&v->lock);
+		if (moved)
+			return 1;
+	}
+	return 0;
+}
+
+static int gc_par_work_available(gc_parallel_t *par) {
+	assert(par);
+	for (size_t i = 0; i < par->count; i++)
+		if (__atomic_load_n(&par->markers[i].shared.used, __ATOMIC_RELAXED))
+			return 1;
+	return 0;
+}
+
+/**@brief give idle markers something to do if we have plenty of work*/
+static void gc_par_share(gc_marker_t *m) {
+	assert(m);
+	gc_parallel_t *par = m->par;
+	if (m->local.used <= GC_WORK_CHUNK || !__atomic_load_n(&par->idle, __ATOMIC_RELAXED))
+		return;
+	if (__atomic_load_n(&m->shared.used, __ATOMIC_RELAXED))
+		return;
+	pthread_mutex_lock(&m->lock);
+	gc_work_move(par, &m->shared, &m->local, GC_WORK_CHUNK / 2);
+	pthread_mutex_unlock(&m->lock);
+}
+
+static void gc_par_mark(lisp_t *l, gc_marker_t *m) {
+	assert(l && m);
+	gc_parallel_t *par = m->par;
+	for (;;) {
+		while (m->local.used) {
+			gc_work_t w = m->local.work[--m->local.used];
+			gc_par_mark_children(l, m, w);
+			gc_par_share(m);
+		}
+		if (gc_par_steal(par, m))
+			continue;
+		__atomic_add_fetch(&par->idle, 1, __ATOMIC_ACQ_REL);
+		for (;;) {
+			if (__atomic_load_n(&par->idle, __ATOMIC_ACQUIRE) == par->running)
+				return;
+			if (gc_par_work_available(par)) {
+				__atomic_sub_fetch(&par->idle, 1, __ATOMIC_ACQ_REL);
+				if (gc_par_steal(par, m))
+					break;
+				__atomic_add_fetch(&par->idle, 1, __ATOMIC_ACQ_REL);
+			}
+			sched_yield();
 		}
 	}
 }
 
+static void *gc_par_thread(void *arg) {
+	gc_marker_t *m = arg;
+	while (!__atomic_load_n(&m->par->go, __ATOMIC_ACQUIRE))
+		sched_yield();
+	gc_par_mark(m->par->l, m);
+	return NULL;
+}
+
+/**@brief mark everything reachable from the gray list with "gc_threads"
+ *	  threads, the calling thread being one of them. If the threads
+ *	  cannot be set up the gray list is left for gc_drain().*/
+static void gc_mark_parallel(lisp_t *l) {
+	assert(l && l->gc_threads > 1);
+	gc_parallel_t par;
+	unsigned started = 0;
+	memset(&par, 0, sizeof(par));
+	par.l = l;
+	par.count = l->gc_threads;
+	if (!(par.markers = calloc(par.count, sizeof(*par.markers))))
+		return;
+	pthread_mutex_init(&par.user, NULL);
+	for (unsigned i = 0; i < par.count; i++) {
+		par.markers[i].par = &par;
+		pthread_mutex_init(&par.markers[i].lock, NULL);
+	}
+	for (size_t i = 0; i < l->gc_gray_used; i++) { /*split up the roots*/
+		gc_work_t w = { l->gc_gray[i], 0, 0 };
+		gc_work_push(&par, &par.markers[i % par.count].shared, w);
+	}
+	l->gc_gray_used = 0;
+	/*markers that fail to start have their work stolen by the others*/
+	for (unsigned i = 1; i < par.count; i++)
+		if (!pthread_create(&par.markers[i].thread, NULL, gc_par_thread, &par.markers[i]))
+			par.markers[i].started = 1, started++;
+	par.running = started + 1;
+	__atomic_store_n(&par.go, 1, __ATOMIC_RELEASE);
+	gc_par_mark(l, &par.markers[0]);
+	for (unsigned i = 1; i < par.count; i++)
+		if (par.markers[i].started)
+			pthread_join(par.markers[i].thread, NULL);
+	for (unsigned i = 0; i < par.count; i++) {
+		free(par.markers[i].local.work);
+		free(par.markers[i].shared.work);
+		pthread_mutex_destroy(&par.markers[i].lock);
+	}
+	pthread_mutex_destroy(&par.user);
+	free(par.markers);
+	if (par.overflow)
+		l->gc_gray_overflow = 1;
+}
+#endif
+
+/**@brief mark everything reachable from the gray list without stopping,
+ *	  in parallel if that is turned on and the heap is large enough*/
+static void gc_drain_all(lisp_t *l) {
+	assert(l);
+#ifdef USE_THREADS
+	if (l->gc_threads > 1 && l->gc_heap >= l->gc_parallel_heap)
+		gc_mark_parallel(l);
+#endif
+	gc_drain(l, 0, 0);
+}
+
+void lisp_gc_write_barrier(lisp_cell_t *x) {
+	assert(x);
+	if (x->uncollectable)
+		return;
+	gc_page_t *p = gc_page_of(x);
+	if (!gc_test_bit(p->marks, x)) /*young cells are always scanned*/
+		return;
+	gc_set_bit(p->remembered, x);
+	p->dirty = 1;
+}
+
+/**@brief mark everything reachable from the old cells that have been
+ *	  written to since the last collection, these are the only
+ *	  pointers from the old generation into the nursery.*/
+static void gc_mark_remembered(lisp_t *l) {
+	assert(l);
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next) {
+			if (!p->dirty)
+				continue;
+			p->dirty = 0;
+			for (size_t i = 0; i < p->bump; i++) {
+				lisp_cell_t *x = gc_page_cell(p, i);
+				if (!gc_test_bit(p->remembered, x))
+					continue;
+				gc_clear_bit(p->remembered, x);
+				gc_mark_children(l, x, 0);
+			}
+		}
+}
+
+/**@brief forget the age of all cells, every cell becomes young again and
+ *	  the remembered set is no longer needed. Any page that has not
+ *	  been swept is swept first, its dead cells could not be told apart
+ *	  from live ones afterwards.*/
+static void gc_clear_marks(lisp_t *l) {
+	assert(l && !l->gc_sweeper);
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next) {
+			if (p->swept == GC_PAGE_UNSWEPT) {
+				gc_sweep_page(l, p);
+				p->swept = GC_PAGE_SWEPT;
+			}
+			memset(p->marks, 0, sizeof(p->marks));
+			memset(p->remembered, 0, sizeof(p->remembered));
+			p->dirty = 0;
+		}
+}
+
+static size_t gc_page_live(gc_page_t *p) {
+	size_t live = 0;
+	for (size_t i = 0; i < GC_MARK_WORDS; i++)
+		live += gc_popcount(p->marks[i]);
+	return live;
+}
+
+/**@brief free the unmarked cells of a page, marked cells survive and are
+ *	  promoted to the old generation as their mark bits are left set.
+ *	  Unmarked cells never have their remembered bit set, so only the
+ *	  mutator writes to the remembered bitmap while a page is swept.*/
+static void gc_sweep_page(lisp_t *l, gc_page_t *p) {
+	assert(l && p);
+	p->free = NULL;
+	p->used = gc_page_live(p);
+	/*only the unmarked cells are touched, live cells are skipped with
+	 * nothing more than a look at the bitmap*/
+	for (size_t i = p->bump; i-- > 0;) {
+		lisp_cell_t *x = gc_page_cell(p, i);
+		if (gc_test_bit(p->marks, x))
+			continue;
+		if (x->type != INVALID && !gc_free(l, x)) {
+			p->used++;
+			continue;
+		}
+		gc_release_cell(p, x);
+	}
+}
+
+/**@brief after marking count the cells that survived and leave the dead
+ *	  ones to be freed by lisp_gc_alloc() or the background sweeper,
+ *	  cells kept alive by lisp_gc_used() are only counted once swept*/
+static void gc_sweep_lazily(lisp_t *l) {
+	assert(l && !l->gc_sweeper);
+	l->gc_heap = 0;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++) {
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next) {
+			if (p->external) { /*free what dead cells hold now*/
+				gc_sweep_page(l, p);
+				p->swept = GC_PAGE_SWEPT;
+			} else {
+				p->used = gc_page_live(p);
+				p->swept = GC_PAGE_UNSWEPT;
+			}
+			l->gc_heap += p->used * p->cell_size;
+		}
+		l->gc_cursor[c] = l->gc_pages[c];
+	}
+}
+
+/**@brief free all unmarked cells now*/
+static void gc_sweep(lisp_t *l) {
+	assert(l);
+	gc_sweep_lazily(l);
+	l->gc_heap = 0;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next) {
+			gc_sweep_page(l, p);
+			p->swept = GC_PAGE_SWEPT;
+			l->gc_heap += p->used * p->cell_size;
+		}
+}
+
+#ifdef USE_THREADS
+typedef struct {
+	lisp_t *l;
+	gc_page_t *pages[GC_SIZE_CLASSES]; /**< pages there were when it started*/
+	pthread_t thread;
+	int stop; /**< set to stop sweeping*/
+} gc_sweeper_t;
+
+/**@brief does the page have dead cells that need more than freeing?*/
+static int gc_page_finalizable(gc_page_t *p) {
+	for (size_t i = 0; i < p->bump; i++) {
+		lisp_cell_t *x = gc_page_cell(p, i);
+		if (gc_test_bit(p->marks, x))
+			continue;
+		if (x->type == IO || x->type == HASH || x->type == USERDEF)
+			return 1;
+	}
+	return 0;
+}
+
+/**@brief sweep pages in the background, pages that have I/O ports, hashes
+ *	  or user defined types to finalize are left to the allocator so
+ *	  that io_close(), hash_destroy() and user defined free functions
+ *	  are only ever called by the thread using the interpreter*/
+static void *gc_sweeper_thread(void *arg) {
+	gc_sweeper_t *s = arg;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = s->pages[c]; p; p = p->next) {
+			if (__atomic_load_n(&s->stop, __ATOMIC_RELAXED))
+				return NULL;
+			if (!gc_page_claim(p))
+				continue;
+			if (gc_page_finalizable(p)) {
+				gc_page_set_state(p, GC_PAGE_UNSWEPT);
+				continue;
+			}
+			gc_sweep_page(s->l, p);
+			gc_page_set_state(p, GC_PAGE_SWEPT);
+		}
+	return NULL;
+}
+#endif
+
+static void gc_sweeper_start(lisp_t *l) {
+	assert(l && !l->gc_sweeper);
+#ifdef USE_THREADS
+	gc_sweeper_t *s;
+	if (l->gc_threads < 2 || l->gc_heap < l->gc_parallel_heap)
+		return;
+	if (!(s = calloc(1, sizeof(*s))))
+		return;
+	s->l = l;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		s->pages[c] = l->gc_pages[c];
+	if (pthread_create(&s->thread, NULL, gc_sweeper_thread, s)) {
+		free(s);
+		return;
+	}
+	l->gc_sweeper = s;
+#endif
+}
+
+/**@brief stop the background sweeper, any pages it has not got to are
+ *	  left for the allocator. This must be done before marking or
+ *	  anything else that looks at the cells of unswept pages.*/
+static void gc_sweeper_stop(lisp_t *l) {
+	assert(l);
+#ifdef USE_THREADS
+	gc_sweeper_t *s = l->gc_sweeper;
+	if (!s)
+		return;
+	__atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+	pthread_join(s->thread, NULL);
+	free(s);
+	l->gc_sweeper = NULL;
+#endif
+}
+
+void lisp_gc_sweep_only(lisp_t * l) {
+	assert(l);
+	if (l->gc_off)
+		return;
+	gc_sweeper_stop(l);
+	l->gc_marking = 0;
+	l->gc_gray_used = 0;
+	l->gc_gray_overflow = 0;
+	gc_clear_marks(l);
+	gc_sweep(l);
+}
+
 lisp_cell_t *lisp_gc_add(lisp_t * l, lisp_cell_t * op) {
 	assert(l);
 	if (l->gc_stack_used++ > l->gc_stack_allocated - 1) {
@@ -138,7 +934,11 @@ lisp_cell_t *lisp_gc_add(lisp_t * l, lisp_cell_t * op) {
 			lisp_out_of_memory(l);
 		l->gc_stack = olist;
 	}
+	if (l->gc_stack_used > l->gc_stack_max)
+		l->gc_stack_max = l->gc_stack_used;
 	l->gc_stack[l->gc_stack_used - 1] = op;	/**<anything reachable in here is not freed*/
+	if (l->gc_marking) /*new cells are allocated gray*/
+		gc_shade(l, op);
 	return op;
 }
 
@@ -157,15 +957,455 @@ void lisp_gc_off(lisp_t * l) {
 	l->gc_off = 1;
 }
 
+static void gc_mark_roots(lisp_t *l) {
+	assert(l);
+	gc_shade(l, l->all_symbols);
+	gc_shade(l, l->top_env);
+	gc_shade(l, l->eq);
+	for (size_t i = 0; i < l->gc_stack_used; i++)
+		gc_shade(l, l->gc_stack[i]);
+}
+
+static double gc_seconds(clock_t start) {
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+void lisp_gc_weak(lisp_t *l, lisp_cell_t *x) {
+	assert(l && x && (is_weak(x) || is_hash(x)));
+	if (l->gc_weak_used >= l->gc_weak_allocated) {
+		size_t n = l->gc_weak_allocated ? l->gc_weak_allocated * 2 : SMALL_DEFAULT_LEN;
+		lisp_cell_t **w = n > l->gc_weak_allocated ? realloc(l->gc_weak, n * sizeof(*l->gc_weak)) : NULL;
+		if (!w)
+			lisp_out_of_memory(l);
+		l->gc_weak = w;
+		l->gc_weak_allocated = n;
+	}
+	l->gc_weak[l->gc_weak_used++] = x;
+}
+
+void lisp_gc_weak_hash(lisp_t *l, lisp_cell_t *h, int keys, int values) {
+	assert(l && h && is_hash(h));
+	const int registered = h->weak_keys || h->weak_values;
+	h->weak_keys = !!keys;
+	h->weak_values = !!values;
+	if (!registered && (keys || values))
+		lisp_gc_weak(l, h);
+}
+
+/**@brief is a cell going to survive the current collection?*/
+static int gc_survives(lisp_cell_t *x) {
+	assert(x);
+	return is_fixnum(x) || x->uncollectable || x->used || gc_test_bit(gc_page_of(x)->marks, x);
+}
+
+static void *gc_dead_key(const char *key, void *val) {
+	UNUSED(key);
+	lisp_cell_t *x = val;
+	return gc_survives(is_cons(x) ? car(x) : x) ? NULL : val;
+}
+
+static void *gc_dead_value(const char *key, void *val) {
+	UNUSED(key);
+	lisp_cell_t *x = val;
+	return gc_survives(is_cons(x) ? cdr(x) : x) ? NULL : val;
+}
+
+static void *gc_dead_key_or_value(const char *key, void *val) {
+	return gc_dead_key(key, val) ? val : gc_dead_value(key, val);
+}
+
+/**@brief once marking is done, clear the weak references to cells that
+ *	  did not survive and remove the entries of weak hashes that refer
+ *	  to them. The pairs of the remaining entries are marked, both of
+ *	  their halves have survived, and weak objects that are themselves
+ *	  garbage are forgotten.*/
+static void gc_clear_weak(lisp_t *l) {
+	assert(l && !l->gc_marking);
+	size_t j = 0;
+	for (size_t i = 0; i < l->gc_weak_used; i++) {
+		lisp_cell_t *x = l->gc_weak[i];
+		if (!gc_survives(x))
+			continue;
+		if (is_weak(x)) {
+			if (!gc_survives(get_weak(x)))
+				x->p[0].v = gsym_nil();
+		} else if (x->weak_keys || x->weak_values) {
+			hash_table_t *h = get_hash(x);
+			hash_remove_if(h, !x->weak_values ? gc_dead_key : !x->weak_keys ? gc_dead_value : gc_dead_key_or_value);
+			for (size_t k = 0; k < h->len; k++)
+				for (hash_entry_t *cur = h->table[k]; cur; cur = cur->next)
+					if (!is_fixnum(cur->val) && !((lisp_cell_t*)cur->val)->uncollectable)
+						gc_set_mark(cur->val);
+		} else {
+			continue;
+		}
+		l->gc_weak[j++] = x;
+	}
+	l->gc_weak_used = j;
+}
+
+/**@brief sort a list of pages so the ones with the most cells in use come
+ *	  first, with a merge sort*/
+static gc_page_t *gc_sort_pages(gc_page_t *p) {
+	gc_page_t head, *tail = &head, *a = p, *b, *slow = p, *fast;
+	if (!p || !p->next)
+		return p;
+	for (fast = p->next; fast && fast->next; fast = fast->next->next)
+		slow = slow->next;
+	b = slow->next;
+	slow->next = NULL;
+	a = gc_sort_pages(a);
+	b = gc_sort_pages(b);
+	while (a && b) {
+		gc_page_t **smaller = a->used >= b->used ? &a : &b;
+		tail->next = *smaller;
+		tail = *smaller;
+		*smaller = (*smaller)->next;
+	}
+	tail->next = a ? a : b;
+	return head.next;
+}
+
+/**@brief put the pages in order so allocation fills the fullest first,
+ *	  and give back to the operating system the empty pages there
+ *	  will be no need for before the next collection. Pages with no
+ *	  marked cells are swept now to find out if they are empty.*/
+static void gc_compact(lisp_t *l) {
+	assert(l && !l->gc_sweeper);
+	size_t keep = l->gc_threshold > l->gc_heap ? l->gc_threshold - l->gc_heap : 0, released = 0;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++) {
+		gc_page_t **prev;
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next)
+			if (!p->used && p->swept == GC_PAGE_UNSWEPT) {
+				gc_sweep_page(l, p);
+				p->swept = GC_PAGE_SWEPT;
+			}
+		l->gc_pages[c] = gc_sort_pages(l->gc_pages[c]);
+		for (prev = &l->gc_pages[c]; *prev && (*prev)->used; prev = &(*prev)->next)
+			;
+		while (*prev) { /*only empty pages are left*/
+			gc_page_t *p = *prev;
+			const size_t space = p->cells * p->cell_size;
+			if (keep >= space) {
+				keep -= space;
+				prev = &p->next;
+				continue;
+			}
+			*prev = p->next;
+			gc_page_deallocate(p);
+			l->gc_page_count--;
+			released++;
+		}
+		l->gc_cursor[c] = l->gc_pages[c];
+	}
+#ifdef __GLIBC__
+	if (released) /*give back memory freed by the sweep as well*/
+		malloc_trim(0);
+#endif
+}
+
+void lisp_gc_set_compact(lisp_t *l, int compact) {
+	assert(l);
+	l->gc_compact = !!compact;
+}
+
+/**@brief count the bytes held outside of the cells by the marked cells,
+ *	  after a full collection this is everything held by live cells*/
+static size_t gc_owned_total(lisp_t *l) {
+	assert(l);
+	size_t owned = 0;
+	for (size_t c = 0; c < GC_SIZE_CLASSES; c++)
+		for (gc_page_t *p = l->gc_pages[c]; p; p = p->next)
+			for (size_t j = 0; j < p->bump; j++) {
+				lisp_cell_t *x = gc_page_cell(p, j);
+				if (gc_test_bit(p->marks, x) && x->type != INVALID)
+					owned += gc_owned_bytes(x);
+			}
+	return owned;
+}
+
+/**@brief would allocating "bytes" more go over the quota?*/
+static int gc_over_quota(lisp_t *l, size_t bytes) {
+	const size_t used = l->gc_heap + l->gc_owned + l->gc_external;
+	return used > l->gc_quota || bytes > l->gc_quota - used;
+}
+
+void lisp_gc_reserve(lisp_t *l, size_t bytes) {
+	assert(l);
+	if (!l->gc_quota || !gc_over_quota(l, bytes))
+		return;
+	lisp_gc_mark_and_sweep(l);
+	if (gc_over_quota(l, bytes))
+		LISP_RECOVER(l, "%y'quota-exceeded%t %d", (intptr_t)l->gc_quota);
+}
+
+/**@brief work out the heap size the next collection should happen at*/
+static size_t gc_next_threshold(lisp_t *l) {
+	assert(l);
+	const size_t used = l->gc_heap + l->gc_external;
+	const double grown = used * l->gc_growth;
+	size_t next = grown >= (double)SIZE_MAX ? SIZE_MAX : (size_t)grown;
+	if (next < l->gc_min_heap)
+		next = l->gc_min_heap;
+	if (l->gc_max_heap && next > l->gc_max_heap)
+		next = l->gc_max_heap;
+	if (l->gc_quota && next > l->gc_quota)
+		next = l->gc_quota;
+	if (next <= used) /*more than the maximum is in use*/
+		next = used + l->gc_min_heap;
+	return next;
+}
+
+/**@brief sweep and finish off a collection of either kind, then schedule
+ *	  the next collection based on how much of the heap survived*/
+static void gc_finish(lisp_t *l, int major, clock_t start) {
+	assert(l);
+	const size_t before = l->gc_heap;
+	gc_clear_weak(l);
+	if (major && l->gc_quota)
+		l->gc_owned = gc_owned_total(l);
+	gc_sweep_lazily(l);
+	l->gc_survival = before ? (double)l->gc_heap / before : 0.0;
+	l->gc_threshold = gc_next_threshold(l);
+	if (major && l->gc_compact)
+		gc_compact(l);
+	l->gc_collectp = 0;
+	l->gc_minor_collections = major ? 0 : l->gc_minor_collections + 1;
+	l->gc_collections++;
+	l->gc_major_collections += !!major;
+	l->gc_pause = gc_seconds(start);
+	l->gc_pause_total += l->gc_pause;
+	if (l->gc_pause < l->gc_cycle_pause)
+		l->gc_pause = l->gc_cycle_pause;
+	if (l->gc_pause > l->gc_pause_max)
+		l->gc_pause_max = l->gc_pause;
+	l->gc_cycle_pause = 0;
+	gc_sweeper_start(l);
+}
+
+/**@brief finish an incremental collection, the roots and any cell written
+ *	  to since marking started are scanned again, nothing that is on
+ *	  the gray list now will be missed as the mutator is not running*/
+static void gc_finish_incremental(lisp_t *l, clock_t start) {
+	assert(l && l->gc_marking);
+	gc_mark_roots(l);
+	gc_mark_remembered(l);
+	gc_drain_all(l);
+	l->gc_marking = 0;
+	gc_finish(l, l->gc_marking_major, start);
+}
+
 void lisp_gc_mark_and_sweep(lisp_t * l) {
 	assert(l);
+	const clock_t start = clock();
 	if (l->gc_off)
 		return;
-	lisp_gc_mark(l, l->all_symbols);
-	lisp_gc_mark(l, l->top_env);
-	for (size_t i = 0; i < l->gc_stack_used; i++)
-		lisp_gc_mark(l, l->gc_stack[i]);
-	lisp_gc_sweep_only(l);
+	gc_sweeper_stop(l);
+	l->gc_marking = 0; /*any incremental collection is abandoned*/
+	l->gc_gray_used = 0;
+	l->gc_gray_overflow = 0;
+	l->gc_cycle_pause = 0;
+	gc_clear_marks(l);
+	gc_mark_roots(l);
+	gc_drain_all(l);
+	gc_finish(l, 1, start);
+}
+
+void lisp_gc_minor(lisp_t *l) {
+	assert(l);
+	const clock_t start = clock();
+	if (l->gc_off)
+		return;
+	if (l->gc_marking) {
+		gc_finish_incremental(l, start);
+		return;
+	}
+	gc_sweeper_stop(l);
+	gc_mark_roots(l);
+	gc_mark_remembered(l);
+	gc_drain_all(l);
+	gc_finish(l, 0, start);
+}
+
+static void gc_slice(lisp_t *l, clock_t start) {
+	assert(l && l->gc_marking);
+	double pause;
+	if (gc_drain(l, l->gc_budget_cells, l->gc_budget_usecs)) {
+		gc_finish_incremental(l, start);
+		return;
+	}
+	pause = gc_seconds(start);
+	l->gc_pause_total += pause;
+	if (pause > l->gc_cycle_pause)
+		l->gc_cycle_pause = pause;
+}
+
+void lisp_gc_slice(lisp_t *l) {
+	assert(l);
+	if (l->gc_off || !l->gc_marking)
+		return;
+	gc_slice(l, clock());
+}
+
+void lisp_gc_collect(lisp_t *l) {
+	assert(l);
+	const int major = l->gc_minor_collections >= GC_MINOR_COLLECTIONS;
+	const clock_t start = clock();
+	if (l->gc_off)
+		return;
+	if (l->gc_marking) { /*the mutator is allocating faster than we mark*/
+		gc_finish_incremental(l, start);
+		return;
+	}
+	gc_sweeper_stop(l);
+	if (!l->gc_budget_cells && !l->gc_budget_usecs) {
+		if (major)
+			lisp_gc_mark_and_sweep(l);
+		else
+			lisp_gc_minor(l);
+		return;
+	}
+	if (major)
+		gc_clear_marks(l);
+	l->gc_gray_used = 0;
+	l->gc_gray_overflow = 0;
+	l->gc_cycle_pause = 0;
+	l->gc_marking = 1;
+	l->gc_marking_major = major;
 	l->gc_collectp = 0;
+	l->gc_threshold = gc_next_threshold(l); /*room to allocate while marking*/
+	gc_mark_roots(l);
+	if (!major)
+		gc_mark_remembered(l);
+	gc_slice(l, start);
+}
+
+void lisp_gc_set_budget(lisp_t *l, size_t cells, unsigned long usecs) {
+	assert(l);
+	l->gc_budget_cells = cells;
+	l->gc_budget_usecs = usecs;
+	if (!cells && !usecs && l->gc_marking && !l->gc_off)
+		gc_finish_incremental(l, clock());
+}
+
+void lisp_gc_set_policy(lisp_t *l, double growth, size_t min_heap, size_t max_heap) {
+	assert(l);
+	l->gc_growth = growth > 1.0 ? growth : GC_GROWTH_FACTOR;
+	l->gc_min_heap = min_heap;
+	l->gc_max_heap = max_heap;
+	l->gc_threshold = gc_next_threshold(l);
+}
+
+void lisp_gc_set_quota(lisp_t *l, size_t bytes) {
+	assert(l);
+	l->gc_quota = bytes;
+	l->gc_threshold = gc_next_threshold(l);
+}
+
+void lisp_gc_account_external(lisp_t *l, lisp_cell_t *x, size_t bytes) {
+	assert(l && x && cell_type(x) == USERDEF);
+	const size_t old = (uintptr_t)x->p[2].v;
+	x->p[2].v = (void *)bytes;
+	l->gc_external = l->gc_external - old + bytes;
+	if (!x->uncollectable) {
+		gc_page_t *p = gc_page_of(x);
+		p->external = p->external - old + bytes;
+	}
+	if (bytes > old)
+		lisp_gc_reserve(l, 0);
+}
+
+int lisp_gc_set_threads(lisp_t *l, unsigned threads) {
+	assert(l);
+#ifndef USE_THREADS
+	if (threads > 1)
+		return -1;
+#endif
+	l->gc_threads = threads;
+	return 0;
+}
+
+void lisp_gc_set_parallel_heap(lisp_t *l, size_t bytes) {
+	assert(l);
+	l->gc_parallel_heap = bytes;
+}
+
+double lisp_gc_survival_rate(lisp_t *l) {
+	assert(l);
+	return l->gc_survival;
+}
+
+double lisp_gc_pause_time(lisp_t *l) {
+	assert(l);
+	return l->gc_pause;
+}
+
+void lisp_gc_set_mark_stack(lisp_t *l, size_t entries) {
+	assert(l);
+	l->gc_gray_max = entries;
+	if (entries && l->gc_gray_allocated > entries && !l->gc_marking) {
+		free(l->gc_gray);
+		l->gc_gray = NULL;
+		l->gc_gray_used = l->gc_gray_allocated = 0;
+	}
+}
+
+/**@brief bytes owned by a cell outside of the heap, as far as we know*/
+static size_t gc_owned_bytes(lisp_cell_t *x) {
+	assert(x);
+	size_t bytes = 0;
+	switch (x->type) {
+	case STRING:
+	case SYMBOL:
+		return gc_inline_string(x) ? 0 : get_length(x) + 1;
+	case IO:
+		if (x->close) /*the port has been freed*/
+			return 0;
+		return sizeof(io_t) + (io_is_string(get_io(x)) ? get_io(x)->max : 0);
+	case HASH:
+	{
+		hash_table_t *h = get_hash(x);
+		bytes = sizeof(*h) + h->len * sizeof(*h->table);
+		for (size_t i = 0; i < h->len; i++)
+			for (hash_entry_t *e = h->table[i]; e; e = e->next)
+				bytes += sizeof(*e) + strlen(e->key) + 1;
+		return bytes;
+	}
+	case PROC:
+		return x->p[3].v ? ((uintptr_t*)x->p[3].v)[0] * sizeof(uintptr_t) : 0;
+	default:
+		return 0;
+	}
+}
+
+void lisp_gc_stats(lisp_t *l, lisp_gc_stats_t *s) {
+	assert(l && s);
+	gc_sweeper_stop(l);
+	memset(s, 0, sizeof(*s));
+	for (size_t i = 0; i < GC_SIZE_CLASSES; i++)
+		for (gc_page_t *p = l->gc_pages[i]; p; p = p->next)
+			for (size_t j = 0; j < p->bump; j++) {
+				lisp_cell_t *x = gc_page_cell(p, j);
+				if (x->type == INVALID)
+					continue;
+				/*the unmarked cells of unswept pages are dead*/
+				if (p->swept == GC_PAGE_UNSWEPT && !x->used && !gc_test_bit(p->marks, x))
+					continue;
+				s->live[x->type]++;
+				s->bytes[x->type] += p->cell_size + gc_owned_bytes(x);
+				if (x->type == USERDEF)
+					s->bytes[x->type] += (uintptr_t)x->p[2].v;
+			}
+	s->heap              = l->gc_heap;
+	s->pages             = l->gc_page_count * GC_PAGE_SIZE;
+	s->external          = l->gc_external;
+	s->allocations       = l->gc_allocations;
+	s->collections       = l->gc_collections;
+	s->major_collections = l->gc_major_collections;
+	s->gc_stack_max      = l->gc_stack_max;
+	s->pause_total       = l->gc_pause_total;
+	s->pause_max         = l->gc_pause_max;
+	s->pause_last        = l->gc_pause;
+	s->survival_last     = l->gc_survival;
 }
 
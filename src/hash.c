@@ -192,6 +192,28 @@ void *hash_foreach(hash_table_t * h, hash_func func) {
 	return NULL;
 }
 
+size_t hash_remove_if(hash_table_t * h, hash_func func) {
+	assert(h && func);
+	size_t removed = 0;
+	for (size_t i = 0; i < h->len; i++)
+		for (hash_entry_t **cur = &h->table[i]; *cur;) {
+			hash_entry_t *e = *cur;
+			if (!(*func) (e->key, e->val)) {
+				cur = &e->next;
+				continue;
+			}
+			*cur = e->next;
+			h->free_key(e->key);
+			h->free_val(e->val);
+			free(e);
+			h->used--;
+			removed++;
+		}
+	if (removed)
+		h->foreach = 0;
+	return removed;
+}
+
 void hash_reset_foreach(hash_table_t * h) {
 	assert(h);
 	h->foreach = 0;
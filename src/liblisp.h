@@ -62,9 +62,10 @@ typedef struct tr_state tr_state_t;     /**< state for translation functions */
 typedef struct cell lisp_cell_t;               /**< a lisp object, or "cell" */
 typedef struct lisp lisp_t;             /**< a full lisp environment */
 typedef lisp_cell_t *(*lisp_subr_func)(lisp_t *, lisp_cell_t *); /**< lisp primitive operations */
+typedef lisp_cell_t *(*lisp_subr_vector_func)(lisp_t *, size_t argc, lisp_cell_t **argv); /**< lisp primitive operations taking an array of arguments*/
 typedef void *(*hash_func)(const char *key, void *val); /**< for hash foreach */
 
-typedef void (*lisp_free_func)(lisp_cell_t *);       /**< function to free a user type*/
+typedef void (*lisp_free_func)(lisp_cell_t *);       /**< function to free a user types data, the cell itself is owned by the collector*/
 typedef void (*lisp_mark_func)(lisp_cell_t *);       /**< marking function for user types*/
 typedef int  (*lisp_equal_func)(lisp_cell_t *, lisp_cell_t *);  /**< equality function for user types*/
 typedef int  (*lisp_print_func)(io_t *, unsigned, lisp_cell_t *); /**< print out user def types*/
@@ -89,11 +90,30 @@ typedef enum {
 	LISP_LOG_LEVEL_LAST_INVALID /**< using an invalid log levels causes an abort*/
 } lisp_log_level;
 
+#define LISP_GC_STATS_TYPES (16) /**< number of object types in lisp_gc_stats_t*/
+
+typedef struct {
+	size_t live[LISP_GC_STATS_TYPES],  /**< objects allocated of each type, indexed by type number*/
+	       bytes[LISP_GC_STATS_TYPES], /**< bytes used by objects of each type, including strings and tables they own*/
+	       heap,          /**< bytes of the heap allocated to objects*/
+	       pages,         /**< bytes of memory the heap is made up of*/
+	       external,      /**< bytes held outside of the heap, see lisp_gc_account_external()*/
+	       allocations,   /**< total number of objects ever allocated*/
+	       collections,   /**< total number of collections, minor and full*/
+	       major_collections, /**< number of full collections*/
+	       gc_stack_max;  /**< most objects ever held on the garbage collection stack*/
+	double pause_total,   /**< total time spent collecting in seconds*/
+	       pause_max,     /**< longest pause ever in seconds*/
+	       pause_last,    /**< longest pause during the last collection*/
+	       survival_last; /**< fraction of the heap that survived the last collection*/
+} lisp_gc_stats_t; /**< garbage collector statistics, see lisp_gc_stats()*/
+
 typedef struct {
 	char *name,        /**< name of function to add*/
 		*validate, /**< validation string see lisp_validate_args(), NULL turns checking off */
 		*docstring;/**< documentation string for function, a short description (<100 chars is advisable)*/
 	lisp_subr_func p; /**< the actual subroutine to add */
+	lisp_subr_vector_func v; /**< or a subroutine taking an array of arguments, used if "p" is NULL*/
 } lisp_module_subroutines_t; /**< structure for the convenience function lisp_add_module_subroutines */
 
 /************************** useful functions *********************************/
@@ -300,6 +320,14 @@ LIBLISP_API void *hash_lookup(const hash_table_t *table, const char *key);
  *  @return void*  the result of the first non-NULL function application**/
 LIBLISP_API void *hash_foreach(hash_table_t *h, hash_func func);
 
+/** @brief  Remove every key-value pair for which "func" returns non-NULL,
+ *          the pairs are freed with the functions the table was made
+ *          with. Any hash_foreach() loop is reset.
+ *  @param  h      table to remove pairs from
+ *  @param  func   function that selects the pairs to remove
+ *  @return size_t the number of pairs removed**/
+LIBLISP_API size_t hash_remove_if(hash_table_t *h, hash_func func);
+
 /** @brief This resets a hash foreach function to the beginning of the
  *         table, so new calls to hash_foreach begin at the first element
  *         in the table.
@@ -618,7 +646,9 @@ LIBLISP_API lisp_cell_t *lisp_extend(lisp_t *l, lisp_cell_t *env, lisp_cell_t *s
 /**@brief  add a new symbol to the list of all symbols, two interned
  *         symbols containing the same name will compare equal with
  *         a pointer comparison, they will be the same object. The
- *         lisp environment will try to free this name!
+ *         lisp environment will try to free this name! If a new symbol
+ *         is made the name belongs to it, and may be freed at once, it
+ *         is not freed if the symbol already exists.
  * @param  l    an initialized lisp structure, used for error handling
  *              and keeping track of interned symbols
  * @param  name name of symbol
@@ -718,6 +748,11 @@ LIBLISP_API int  is_userdef(lisp_cell_t *x);
  * @return int zero if check fails, non zero if check passes  */
 LIBLISP_API int  is_usertype(lisp_cell_t *x, int type);
 
+/**@brief  true if 'x' is a weak reference
+ * @param  x   value to perform check on
+ * @return int zero if check fails, non zero if check passes */
+LIBLISP_API int  is_weak(lisp_cell_t *x);
+
 /**@brief  true if 'x' can be applied (is a function)
  * @param  x   value to perform check on
  * @return int zero if check fails, non zero if check passes  */
@@ -742,7 +777,10 @@ LIBLISP_API int  is_list(lisp_cell_t *x);
  * @return lisp_cell_t* a new list of values */
 LIBLISP_API lisp_cell_t *mk_list(lisp_t *l, lisp_cell_t *x, ...);
 
-/**@brief  Make a lisp cell from an integer
+/**@brief  Make a lisp cell from an integer, integers that fit in a pointer
+ *         less one bit are held in the returned pointer itself and do not
+ *         allocate, so they should only be inspected with the functions
+ *         in this header.
  * @param  l lisp environment for error handling and garbage collection
  * @param  d value of new integer
  * @return lisp_cell_t* new integer lisp lisp_cell_t */
@@ -773,6 +811,18 @@ LIBLISP_API lisp_cell_t *mk_io(lisp_t *l, io_t *x);
  * @return lisp_cell_t* returns a new lisp subroutine object */
 LIBLISP_API lisp_cell_t *mk_subr(lisp_t *l, lisp_subr_func p, const char *fmt, const char *doc);
 
+/**@brief  make a lisp subroutine that is passed its arguments as an array
+ *         instead of as a list, so calling it does not allocate. The
+ *         array is only valid until the subroutine returns.
+ * @param  l    lisp environment for error handling and garbage collection
+ * @param  p    function to make into a lisp subroutine, it is passed the
+ *              number of arguments and an array of them
+ * @param  fmt  format of function validation string, as for mk_subr(),
+ *              it is checked against the array.
+ * @param  doc  documentation string, this can be NULL.
+ * @return lisp_cell_t* returns a new lisp subroutine object */
+LIBLISP_API lisp_cell_t *mk_subr_vector(lisp_t *l, lisp_subr_vector_func p, const char *fmt, const char *doc);
+
 /**@brief  make a lisp lambda procedure cell.
  * @param  l    lisp environment for error handling and garbage collection
  * @param  args a list of argument names to the function
@@ -816,6 +866,13 @@ LIBLISP_API lisp_cell_t *mk_immutable_str(lisp_t *l, const char *s);
  * @return lisp_cell_t* a hash table accessible from a lisp interpreter */
 LIBLISP_API lisp_cell_t *mk_hash(lisp_t *l, hash_table_t *h);
 
+/**@brief  make a weak reference, it does not stop the object it refers to
+ *         from being collected, after which it refers to nil
+ * @param  l lisp environment for error handling and garbage collection
+ * @param  x the object to refer to
+ * @return lisp_cell_t* a weak reference to "x"*/
+LIBLISP_API lisp_cell_t *mk_weak(lisp_t *l, lisp_cell_t *x);
+
 /**@brief  make a user defined type
  * @param  l lisp environment for error handling and garbage collection
  * @param  x    data field for the new user defined type
@@ -856,7 +913,8 @@ LIBLISP_API intptr_t get_int(lisp_cell_t *x);
 LIBLISP_API io_t *get_io(lisp_cell_t *x);
 
 /**@brief  get a lisp cell to a primitive func ptr
- * @param  x    'x' must be a lisp object of a subroutine type
+ * @param  x    'x' must be a lisp object of a subroutine type, made
+ *              with mk_subr() and not mk_subr_vector()
  * @return subr an internal lisp subroutine function*/
 LIBLISP_API lisp_subr_func get_subr(lisp_cell_t *x);
 
@@ -875,6 +933,25 @@ LIBLISP_API lisp_cell_t *get_proc_code(lisp_cell_t *x);
  * @return lisp_cell_t* */
 LIBLISP_API lisp_cell_t *get_proc_env(lisp_cell_t *x);
 
+/**@brief  run a procedure with the bytecode virtual machine instead of
+ *         evaluating its code each time it is called, the procedure is
+ *         compiled when it is next called. Procedures made with "compile"
+ *         have this turned on.
+ * @param  x   a procedure (made with "lambda" or "compile")
+ * @param  on  non zero to use the virtual machine, zero for the evaluator*/
+LIBLISP_API void lisp_set_bytecode(lisp_cell_t *x, int on);
+
+/**@brief  Turn on or off the optimizations "compile" makes to the code of
+ *         the procedures it makes, they are on by default. Primitives
+ *         without side effects are called on constant arguments, small
+ *         procedures made by "compile" are put in place of calls to them
+ *         and branches that cannot be taken are removed. Redefining a
+ *         procedure is seen by the code it was put into, but redefining a
+ *         primitive does not change calls to it already folded.
+ * @param  l   the lisp environment
+ * @param  on  non zero to optimize, zero to leave code as it is written*/
+LIBLISP_API void lisp_set_optimize(lisp_t *l, int on);
+
 /**@brief  get the documentation string for a lambda/f-expr/subroutine
  * @param  x
  * @return lisp_cell_t* */
@@ -915,6 +992,11 @@ LIBLISP_API lisp_float_t get_float(lisp_cell_t *x);
  * @return hash_table_t* */
 LIBLISP_API hash_table_t *get_hash(lisp_cell_t *x);
 
+/**@brief  get the object a weak reference refers to
+ * @param  x a weak reference
+ * @return lisp_cell_t* the object, or nil if it has been collected*/
+LIBLISP_API lisp_cell_t *get_weak(lisp_cell_t *x);
+
 /**@brief  float/int (arithmetic type) to int
  * @param  x float or integer
  * @return intptr_t integer */
@@ -992,7 +1074,7 @@ LIBLISP_API lisp_cell_t *gsym_dowhile(void);
 
 /**@brief  return a new token representing a new type
  * @param  l lisp environment to put the new type in
- * @param  f function to call when freeing type, optional (but free() will be used)
+ * @param  f function to call when freeing type, optional, it should only release the data held by the cell and not the cell itself
  * @param  m function to call when marking type, optional
  * @param  e function to call when comparing two types, optional
  * @param  p function to call when printing type, optional
@@ -1000,6 +1082,17 @@ LIBLISP_API lisp_cell_t *gsym_dowhile(void);
  *                number representing a user defined token*/
 LIBLISP_API int new_user_defined_type(lisp_t *l, lisp_free_func f, lisp_mark_func m, lisp_equal_func e, lisp_print_func p);
 
+/**@brief  Tell the garbage collector how much memory a user defined object
+ *         holds outside of the lisp heap, such as a buffer allocated by
+ *         the library it wraps. These bytes count towards when the next
+ *         collection happens, the quota set by lisp_gc_set_quota() and the
+ *         statistics from lisp_gc_stats() until the object is collected.
+ *         It can be called again whenever the amount changes.
+ * @param  l     lisp environment the object belongs to
+ * @param  x     a user defined object, made with mk_user()
+ * @param  bytes number of bytes the object now holds*/
+LIBLISP_API void lisp_gc_account_external(lisp_t *l, lisp_cell_t *x, size_t bytes);
+
 /**@brief determines whether a string contains a number that
  *        can be converted with strtol.
  *        matches "(+|-)?(0[xX][0-9a-fA-F]+|0[0-7]*|[1-9][0-9]+)"
@@ -1066,7 +1159,7 @@ LIBLISP_API lisp_cell_t *lisp_environment(lisp_t *l);
 
 /**@brief  This is a convince function that takes a pointer to an array of
  *         structures, the structures contain the information needed
- *         for a call to lisp_add_subr().
+ *         for a call to lisp_add_subr() or lisp_add_subr_vector().
  * @param  l   interpreter to add lisp routines to
  * @param  ms  array of structures containing routines to add to an interpreter
  * @param  len length of lisp_module_subroutines_t array, if this is zero then
@@ -1179,6 +1272,17 @@ LIBLISP_API lisp_cell_t *lisp_add_cell(lisp_t *l, const char *sym, lisp_cell_t *
  *                otherwise. You shouldn't do anything with pointer**/
 LIBLISP_API lisp_cell_t *lisp_add_subr(lisp_t *l, const char *name, lisp_subr_func func, const char *fmt, const char *doc);
 
+/** @brief  Add a subroutine taking an array of arguments, see
+ *          mk_subr_vector(), as lisp_add_subr() adds one taking a list.
+ *  @param  l     lisp environment to add primitive to
+ *  @param  name  name to call the function primitive by
+ *  @param  func  function primitive
+ *  @param  fmt   format string checked against the arguments (can be NULL)
+ *  @param  doc   documentation string (can be NULL)
+ *  @return lisp_cell_t* pointer to extended environment if successful, NULL
+ *                otherwise.**/
+LIBLISP_API lisp_cell_t *lisp_add_subr_vector(lisp_t *l, const char *name, lisp_subr_vector_func func, const char *fmt, const char *doc);
+
 /** @brief  Initialize a lisp environment. By default it will read
  *          from stdin, print to stdout and log errors to stderr.
  *  @return lisp*    A fully initialized lisp environment or NULL**/
@@ -1397,13 +1501,134 @@ LIBLISP_API void lisp_gc_not_used(lisp_cell_t *x);
  * @param op object to mark*/
 LIBLISP_API void lisp_gc_mark(lisp_t *l, lisp_cell_t *op);
 
-/**@brief Mark all reachable objects then perform a sweep. To prevent
+/**@brief Mark all reachable objects then perform a sweep, this is a full
+ *        collection of both the young and old generations. To prevent
  *        an object from being collected during the next garbage collection
  *        cycle, you can use lisp_gc_mark(). This will only prevent the objects
- *        collection on this cycle, not the cycle after this one.
+ *        collection until the next full collection.
  * @param l      the lisp environment to perform the mark and sweep in**/
 LIBLISP_API void lisp_gc_mark_and_sweep(lisp_t *l);
 
+/**@brief Perform a minor collection, only objects allocated since the last
+ *        collection are considered for collection, objects that survive
+ *        it become part of the old generation.
+ * @param l      the lisp environment to perform the collection in**/
+LIBLISP_API void lisp_gc_minor(lisp_t *l);
+
+/**@brief The write barrier must be called after a lisp object has been
+ *        stored inside of another object, other than by set_car() and
+ *        set_cdr() which call it themselves, for example after inserting
+ *        into the hash of a HASH object, or after storing an object in
+ *        a user defined type that marks its contents.
+ * @param x      the object that has been written to**/
+LIBLISP_API void lisp_gc_write_barrier(lisp_cell_t *x);
+
+/**@brief Set the amount of work done in each slice of incremental marking,
+ *        when a budget is set collections triggered by the allocator mark
+ *        objects a slice at a time in between allocations instead of
+ *        stopping the interpreter for the entire mark phase. Either limit
+ *        can be zero, if both are zero the collector stops the world.
+ * @param l      the lisp environment to set the budget in
+ * @param cells  maximum number of objects to mark per slice
+ * @param usecs  maximum time in microseconds to spend marking per slice**/
+LIBLISP_API void lisp_gc_set_budget(lisp_t *l, size_t cells, unsigned long usecs);
+
+/**@brief Limit the size of the stack of objects waiting to have their
+ *        contents marked, when it is full the objects that do not fit
+ *        are left until the stack is empty, then the whole heap is
+ *        scanned for them. A small stack uses less memory while marking
+ *        deeply nested or very wide structures at the cost of time.
+ * @param l       the lisp environment to set the limit in
+ * @param entries most objects the mark stack may hold, 0 for no limit**/
+LIBLISP_API void lisp_gc_set_mark_stack(lisp_t *l, size_t entries);
+
+/**@brief Set the policy used to decide when to collect garbage, after each
+ *        collection the next one is scheduled for when the heap has grown
+ *        to "growth" times the size of the objects that survived it. The
+ *        heap size to collect at is never less than "min_heap" and never
+ *        more than "max_heap", unless more than that is already in use,
+ *        in which case a collection happens after "min_heap" more bytes
+ *        have been allocated.
+ * @param l        the lisp environment to set the policy in
+ * @param growth   growth factor of the heap, must be greater than one
+ * @param min_heap heap size in bytes below which nothing is collected
+ * @param max_heap maximum heap size in bytes to collect at, 0 is no limit**/
+LIBLISP_API void lisp_gc_set_policy(lisp_t *l, double growth, size_t min_heap, size_t max_heap);
+
+/**@brief Set the number of threads used to mark objects when the world is
+ *        stopped for a collection, this only has an effect on large heaps
+ *        and if the library was compiled with USE_THREADS. Incremental
+ *        marking slices are always done by the calling thread. User
+ *        defined mark functions are never called concurrently. With more
+ *        than one thread dead objects are also freed by a thread in the
+ *        background, apart from I/O ports, hashes and user defined types
+ *        which are freed by the thread allocating.
+ * @param l        the lisp environment to set the thread count of
+ * @param threads  number of threads to mark with, 0 or 1 for no extra threads
+ * @return int     0 on success, -1 if threads are not supported**/
+LIBLISP_API int lisp_gc_set_threads(lisp_t *l, unsigned threads);
+
+/**@brief Set the size the heap has to be for the threads set with
+ *        lisp_gc_set_threads() to be used, on smaller heaps starting
+ *        them costs more than it saves. The default is 64MiB.
+ * @param l        the lisp environment to set the heap size of
+ * @param bytes    smallest heap in bytes to mark and sweep in parallel**/
+LIBLISP_API void lisp_gc_set_parallel_heap(lisp_t *l, size_t bytes);
+
+/**@brief Make the keys or values of a hash weak, an entry is removed from
+ *        the hash after a collection in which its weak key or value was
+ *        collected. Entries are expected to be (key . value) pairs, as
+ *        made by "hash-insert", other entries count as both.
+ * @param l      the lisp environment the hash belongs to
+ * @param h      the hash to change
+ * @param keys   non zero to make the keys weak
+ * @param values non zero to make the values weak**/
+LIBLISP_API void lisp_gc_weak_hash(lisp_t *l, lisp_cell_t *h, int keys, int values);
+
+/**@brief Turn compaction on or off, objects are never moved but after each
+ *        full collection the pages objects are allocated from are put in
+ *        order so the fullest are filled first, letting the others empty
+ *        out. Empty pages that will not be needed before the next
+ *        collection are returned to the operating system. This makes
+ *        full collections a little longer. It is off by default and can
+ *        be turned on any time after lisp_init().
+ * @param l        the lisp environment to set compaction for
+ * @param compact  non zero to turn compaction on**/
+LIBLISP_API void lisp_gc_set_compact(lisp_t *l, int compact);
+
+/**@brief Limit the memory an interpreter may use, counting its objects and
+ *        the strings, hashes and I/O buffers they hold. When allocating
+ *        would go over the limit a full collection is done first, if that
+ *        does not free enough a recoverable error is thrown, so only the
+ *        interpreter that went over the limit is affected. Memory held
+ *        outside of objects is only counted exactly after full
+ *        collections, in between it is estimated from what is allocated.
+ * @param l      the lisp environment to limit
+ * @param bytes  the limit in bytes, 0 for no limit**/
+LIBLISP_API void lisp_gc_set_quota(lisp_t *l, size_t bytes);
+
+/**@brief Get the fraction of the heap that survived the last collection
+ * @param  l      the lisp environment
+ * @return double survival rate between 0 and 1**/
+LIBLISP_API double lisp_gc_survival_rate(lisp_t *l);
+
+/**@brief Get the longest time the interpreter was paused during the last
+ *        collection, for an incremental collection this is the longest
+ *        slice of work, for any other it is the entire collection.
+ * @param  l      the lisp environment
+ * @return double pause time in seconds**/
+LIBLISP_API double lisp_gc_pause_time(lisp_t *l);
+
+/**@brief Get statistics about the garbage collector and allocator, the
+ *        counters are kept up to date as the interpreter runs but the
+ *        per type counts are worked out by walking the heap when this
+ *        is called. Objects found to be dead by the last collection are
+ *        not counted, but the young objects that have become unreachable
+ *        since then are.
+ * @param l      the lisp environment to get the statistics of
+ * @param s      structure to write the statistics to**/
+LIBLISP_API void lisp_gc_stats(lisp_t *l, lisp_gc_stats_t *s);
+
 /**@brief  Get the status of the garbage collector in a lisp environment,
  *         that is whether it is currently enabled. It defaults to being
  *         on.
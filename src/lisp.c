@@ -35,23 +35,30 @@ void lisp_out_of_memory(lisp_t *l) {
 
 void *lisp_calloc(lisp_t *l, size_t size) {
 	assert(l);
+	lisp_gc_reserve(l, size);
 	void *ret = calloc(size, 1);
 	if (!ret)
 		lisp_out_of_memory(l);
+	l->gc_owned += size;
 	return ret;
 }
 
 char *lisp_strdup(lisp_t *l, const char *s) {
 	assert(l && s);
+	const size_t size = strlen(s) + 1;
+	lisp_gc_reserve(l, size);
 	char *r = lstrdup(s);
 	if (!r)
 		lisp_out_of_memory(l);
+	l->gc_owned += size;
 	return r;
 }
 
 int lisp_add_module_subroutines(lisp_t *l, const lisp_module_subroutines_t *ms, size_t len) {
 	for (size_t i = 0; ms[i].name && (!len || i < len); i++)
-		if (!lisp_add_subr(l, ms[i].name, ms[i].p, ms[i].validate, ms[i].docstring))
+		if (!(ms[i].p ?
+			lisp_add_subr(l, ms[i].name, ms[i].p, ms[i].validate, ms[i].docstring) :
+			lisp_add_subr_vector(l, ms[i].name, ms[i].v, ms[i].validate, ms[i].docstring)))
 			return -1;
 	return 0;
 }
@@ -61,6 +68,11 @@ lisp_cell_t *lisp_add_subr(lisp_t * l, const char *name, lisp_subr_func func, co
 	return lisp_extend_top(l, lisp_intern(l, lisp_strdup(l, name)), mk_subr(l, func, fmt, doc));
 }
 
+lisp_cell_t *lisp_add_subr_vector(lisp_t * l, const char *name, lisp_subr_vector_func func, const char *fmt, const char *doc) {
+	assert(l && name && func);	/*fmt and doc are optional */
+	return lisp_extend_top(l, lisp_intern(l, lisp_strdup(l, name)), mk_subr_vector(l, func, fmt, doc));
+}
+
 lisp_cell_t *lisp_get_all_symbols(lisp_t * l) {
 	assert(l);
 	return l->all_symbols;
@@ -84,9 +96,7 @@ void lisp_destroy(lisp_t * l) {
 		io_close(lisp_get_output(l));
 	if (lisp_get_input(l))
 		io_close(lisp_get_input(l));
-	free(l->input);
-	free(l->output);
-	free(l->logging);
+	lisp_gc_release(l);
 	free(l);
 }
 
@@ -119,17 +129,21 @@ int lisp_print(lisp_t * l, lisp_cell_t * ob) {
 lisp_cell_t *lisp_eval(lisp_t * l, lisp_cell_t * exp) {
 	assert(l && exp);
 	int restore_used, r;
+	const size_t gc_stack_used = l->gc_stack_used;
 	jmp_buf restore;
 	if (l->recover_init) {
 		memcpy(restore, l->recover, sizeof(jmp_buf));
 		restore_used = 1;
 	}
 	if ((r = setjmp(l->recover))) {
+		l->gc_stack_used = gc_stack_used; /*let the failed evaluation be collected*/
 		LISP_RECOVER_RESTORE(restore_used, l, restore);
 		return r > 0 ? l->error : NULL;
 	}
 	l->recover_init = 1;
 	lisp_cell_t *ret = eval(l, 0, exp, l->top_env);
+	l->gc_stack_used = gc_stack_used; /*only the result is kept reachable*/
+	lisp_gc_add(l, ret);
 	LISP_RECOVER_RESTORE(restore_used, l, restore);
 	return ret;
 }
@@ -140,6 +154,7 @@ lisp_cell_t *lisp_eval_string(lisp_t * l, const char *evalme) {
 	io_t *in = NULL;
 	lisp_cell_t *ret;
 	volatile int restore_used = 0, r;
+	const size_t gc_stack_used = l->gc_stack_used;
 	jmp_buf restore;
 	if (!(in = io_sin(evalme, strlen(evalme))))
 		return NULL;
@@ -149,12 +164,15 @@ lisp_cell_t *lisp_eval_string(lisp_t * l, const char *evalme) {
 	}
 	if ((r = setjmp(l->recover))) {
 		io_close(in);
+		l->gc_stack_used = gc_stack_used;
 		LISP_RECOVER_RESTORE(restore_used, l, restore);
 		return r > 0 ? l->error : NULL;
 	}
 	l->recover_init = 1;
 	ret = eval(l, 0, reader(l, in), l->top_env);
 	io_close(in);
+	l->gc_stack_used = gc_stack_used; /*only the result is kept reachable*/
+	lisp_gc_add(l, ret);
 	LISP_RECOVER_RESTORE(restore_used, l, restore);
 	return ret;
 }
@@ -165,6 +165,11 @@ void bignum_destroy(bignum * n) {
 	free(n);
 }
 
+size_t bignum_size(bignum * n) {
+	assert(n);
+	return sizeof(*n) + n->allocated;
+}
+
 int bignum_compare(bignum * a, bignum * b) {
 	size_t i = 0;
 	assert(a && b);
@@ -37,6 +37,11 @@ bignum *bignum_create(int initialize_to, size_t len);
  *  @param    n         Bignum to destroy, freeing memory in the process **/
 void bignum_destroy(bignum * n);
 
+/** @brief    Get the amount of memory a bignum is using
+ *  @param    n         Bignum to get the size of
+ *  @return   size_t    Size of the bignum and its digits in bytes **/
+size_t bignum_size(bignum * n);
+
 /** @brief    Compare two bigums returning the result
  *  @param    a     Bignum 'a'
  *  @param    b     Bignum 'b'
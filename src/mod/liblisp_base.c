@@ -60,12 +60,12 @@ static lisp_cell_t *subr_modf(lisp_t * l, lisp_cell_t * args)
 	return cons(l, mk_float(l, intpart), mk_float(l, fracpart));
 }
 
-#define X(SUBR, VALIDATION, DOCSTRING) { # SUBR, VALIDATION, MK_DOCSTR( #SUBR, DOCSTRING), subr_ ## SUBR },
+#define X(SUBR, VALIDATION, DOCSTRING) { # SUBR, VALIDATION, MK_DOCSTR( #SUBR, DOCSTRING), subr_ ## SUBR, NULL },
 static lisp_module_subroutines_t math_primitives[] = {
 	MATH_UNARY_LIST		/*all of the subr functions */
-	{ "modf", "a", MK_DOCSTR("modf", "split a float into integer and fractional parts"), subr_modf},
-	{ "pow", "a a", MK_DOCSTR("pow:", "raise a base to a power"), subr_pow},
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ "modf", "a", MK_DOCSTR("modf", "split a float into integer and fractional parts"), subr_modf, NULL},
+	{ "pow", "a a", MK_DOCSTR("pow:", "raise a base to a power"), subr_pow, NULL},
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 #undef X
 
@@ -143,12 +143,17 @@ ISX_LIST /*defines lisp subroutines for checking whether a string only contains
 	X("documentation",  subr_doc_string, "x",   "return the documentation string from a procedure")\
 	X("errno",      subr_errno,      "",    "return the current errno")\
 	X("gc",         subr_gc,         "",    "force the collection of garbage")\
+	X("gc-budget",  subr_gc_budget,  "d d", "set the objects and microseconds per slice of incremental garbage collection, (gc-budget 0 0) turns it off")\
+	X("gc-compact", subr_gc_compact, "b",   "turn on or off compaction, returning empty pages of the heap to the system")\
+	X("compile-optimize", subr_compile_optimize, "b", "turn on or off constant folding, inlining and removal of dead branches by compile")\
+	X("gc-quota",   subr_gc_quota,   "d",   "limit the bytes the interpreter may use, 0 for no limit")\
+	X("gc-stats",   subr_gc_stats,   "",    "return (allocations collections full-collections heap-bytes page-bytes external-bytes gc-stack-max pause-total pause-max pause-last survival ((type live bytes)...))")\
 	X("ilog2",      subr_ilog2,      "d",   "compute the binary logarithm of an integer")\
 	X("ipow",       subr_ipow,       "d d", "compute the integer exponentiation of two numbers")\
 	X("set-locale", subr_setlocale,  "d Z", "set the locale, this affects global state!")\
 	X("procedure-arguments",  subr_proc_args,  "l",   "return the arguments for a lambda or F-expression")\
 	X("procedure-code",  subr_proc_code,  "l",   "return the code from a lambda or F-expression")\
-	X("procedure-environment",   subr_proc_env,   "l",   "return the environment captured for a lambda or F-expression")\
+	X("procedure-bytecode", subr_proc_bytecode, "p b", "run a procedure with the bytecode virtual machine if t, or the evaluator if nil")\
 	X("random",     subr_rand,       "",    "return a pseudo random number generator")\
 	X("seed",       subr_seed,       "d d", "seed the pseudo random number generator")\
 	X("string-not-span", subr_strcspn,    "Z Z", "offset into first string of first occurrence of character in second string")\
@@ -168,10 +173,10 @@ ISX_LIST /*defines lisp subroutines for checking whether a string only contains
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
 
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t main_primitives[] = {
 	SUBROUTINE_XLIST		/*all of the subr functions */
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 #undef X
 
@@ -324,10 +329,11 @@ static lisp_cell_t *subr_proc_args(lisp_t * l, lisp_cell_t * args)
 	return get_proc_args(car(args));
 }
 
-static lisp_cell_t *subr_proc_env(lisp_t * l, lisp_cell_t * args)
+static lisp_cell_t *subr_proc_bytecode(lisp_t * l, lisp_cell_t * args)
 {
 	UNUSED(l);
-	return get_proc_env(car(args));
+	lisp_set_bytecode(car(args), !is_nil(CADR(args)));
+	return car(args);
 }
 
 static lisp_cell_t *subr_validation_string(lisp_t * l, lisp_cell_t * args)
@@ -359,6 +365,52 @@ static lisp_cell_t *subr_gc(lisp_t * l, lisp_cell_t * args)
 	return gsym_tee();
 }
 
+static lisp_cell_t *subr_gc_budget(lisp_t * l, lisp_cell_t * args)
+{
+	if (get_int(car(args)) < 0 || get_int(CADR(args)) < 0)
+		LISP_RECOVER(l, "\"expected positive integers\"\n '%S", args);
+	lisp_gc_set_budget(l, get_int(car(args)), get_int(CADR(args)));
+	return gsym_tee();
+}
+
+static lisp_cell_t *subr_gc_compact(lisp_t * l, lisp_cell_t * args)
+{
+	lisp_gc_set_compact(l, !is_nil(car(args)));
+	return car(args);
+}
+
+static lisp_cell_t *subr_compile_optimize(lisp_t * l, lisp_cell_t * args)
+{
+	lisp_set_optimize(l, !is_nil(car(args)));
+	return car(args);
+}
+
+static lisp_cell_t *subr_gc_quota(lisp_t * l, lisp_cell_t * args)
+{
+	if (get_int(car(args)) < 0)
+		LISP_RECOVER(l, "\"expected a positive integer\"\n '%S", args);
+	lisp_gc_set_quota(l, get_int(car(args)));
+	return car(args);
+}
+
+static lisp_cell_t *subr_gc_stats(lisp_t * l, lisp_cell_t * args)
+{
+	lisp_gc_stats_t s;
+	lisp_cell_t *types = gsym_nil();
+	UNUSED(args);
+	lisp_gc_stats(l, &s);
+	for (int i = LISP_GC_STATS_TYPES - 1; i >= 0; i--)
+		if (s.live[i])
+			types = cons(l, mk_list(l, mk_int(l, i), mk_int(l, s.live[i]), mk_int(l, s.bytes[i]), NULL), types);
+	return mk_list(l,
+		mk_int(l, s.allocations), mk_int(l, s.collections),
+		mk_int(l, s.major_collections), mk_int(l, s.heap), mk_int(l, s.pages),
+		mk_int(l, s.external),
+		mk_int(l, s.gc_stack_max), mk_float(l, s.pause_total),
+		mk_float(l, s.pause_max), mk_float(l, s.pause_last),
+		mk_float(l, s.survival_last), types, NULL);
+}
+
 static lisp_cell_t *subr_ilog2(lisp_t * l, lisp_cell_t * args)
 {
 	return mk_int(l, ilog2(get_int(car(args))));
@@ -27,10 +27,10 @@
 #define X(NAME, SUBR, VALIDATION , DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, lisp_cell_t *args);
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t primitives[] = {
 	SUBROUTINE_XLIST	/*all of the subr functions */
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 
 #undef X
@@ -40,7 +40,6 @@ static int ud_bignum = 0;
 static void ud_bignum_free(lisp_cell_t * f)
 {
 	bignum_destroy(get_user(f));
-	free(f);
 }
 
 static int ud_bignum_print(io_t * o, unsigned depth, lisp_cell_t * f)
@@ -53,12 +52,21 @@ static int ud_bignum_print(io_t * o, unsigned depth, lisp_cell_t * f)
 	return ret;
 }
 
+/**@brief make a bignum object, the collector is told about the memory the
+ *        bignum uses so it collects garbage bignums sooner*/
+static lisp_cell_t *mk_bignum(lisp_t * l, bignum * b)
+{
+	lisp_cell_t *ret = mk_user(l, b, ud_bignum);
+	lisp_gc_account_external(l, ret, bignum_size(b));
+	return ret;
+}
+
 static lisp_cell_t *subr_bignum_create(lisp_t * l, lisp_cell_t * args)
 {
 	bignum *b;
 	if (!(b = bignum_create(get_int(car(args)), 16)))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	return mk_user(l, b, ud_bignum);
+	return mk_bignum(l, b);
 }
 
 static lisp_cell_t *subr_bignum_multiply(lisp_t * l, lisp_cell_t * args)
@@ -68,7 +76,7 @@ static lisp_cell_t *subr_bignum_multiply(lisp_t * l, lisp_cell_t * args)
 		LISP_RECOVER(l, "\"expected (bignum bignum)\" '%S", args);
 	if (!(b = bignum_multiply(get_user(car(args)), get_user(CADR(args)))))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	return mk_user(l, b, ud_bignum);
+	return mk_bignum(l, b);
 }
 
 static lisp_cell_t *subr_bignum_add(lisp_t * l, lisp_cell_t * args)
@@ -78,7 +86,7 @@ static lisp_cell_t *subr_bignum_add(lisp_t * l, lisp_cell_t * args)
 		LISP_RECOVER(l, "\"expected (bignum bignum)\" '%S", args);
 	if (!(b = bignum_add(get_user(car(args)), get_user(CADR(args)))))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	return mk_user(l, b, ud_bignum);
+	return mk_bignum(l, b);
 }
 
 static lisp_cell_t *subr_bignum_subtract(lisp_t * l, lisp_cell_t * args)
@@ -88,7 +96,7 @@ static lisp_cell_t *subr_bignum_subtract(lisp_t * l, lisp_cell_t * args)
 		LISP_RECOVER(l, "\"expected (bignum bignum)\" '%S", args);
 	if (!(b = bignum_subtract(get_user(car(args)), get_user(CADR(args)))))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	return mk_user(l, b, ud_bignum);
+	return mk_bignum(l, b);
 }
 
 static lisp_cell_t *subr_bignum_divide(lisp_t * l, lisp_cell_t * args)
@@ -99,7 +107,7 @@ static lisp_cell_t *subr_bignum_divide(lisp_t * l, lisp_cell_t * args)
 		LISP_RECOVER(l, "\"expected (bignum bignum)\" '%S", args);
 	if (!(d = bignum_divide(get_user(car(args)), get_user(CADR(args))), ud_bignum))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	ret = cons(l, mk_user(l, d->quotient, ud_bignum), mk_user(l, d->remainder, ud_bignum));
+	ret = cons(l, mk_bignum(l, d->quotient), mk_bignum(l, d->remainder));
 	free(d);
 	return ret;
 }
@@ -119,7 +127,7 @@ static lisp_cell_t *subr_bignum_from_string(lisp_t * l, lisp_cell_t * args)
 	bignum *b;
 	if (!(b = bignum_strtobig(get_str(car(args)), 10)))
 		LISP_HALT(l, "\"%s\"", "out of memory");
-	return mk_user(l, b, ud_bignum);
+	return mk_bignum(l, b);
 }
 
 int lisp_module_initialize(lisp_t *l)
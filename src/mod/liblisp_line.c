@@ -166,10 +166,10 @@ static lisp_cell_t *subr_readline(lisp_t * l, lisp_cell_t * args)
 #define X(NAME, SUBR, VALIDATION, DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, lisp_cell_t *args);
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t primitives[] = {
 	SUBROUTINE_XLIST	/*all of the subr functions */
-	{NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 #undef X
 
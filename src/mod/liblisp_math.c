@@ -47,13 +47,13 @@ SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
 
 static lisp_module_subroutines_t primitives[] = {
-#define X(SUBR, VALIDATION, DOCSTRING) { # SUBR, VALIDATION, MK_DOCSTR( #SUBR, DOCSTRING), subr_ ## SUBR },
+#define X(SUBR, VALIDATION, DOCSTRING) { # SUBR, VALIDATION, MK_DOCSTR( #SUBR, DOCSTRING), subr_ ## SUBR, NULL },
 	MATH_UNARY_LIST
 #undef X
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(#SUBR, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(#SUBR, DOCSTRING), SUBR, NULL },
 	SUBROUTINE_XLIST
 #undef X
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 
 static lisp_cell_t *subr_finite(lisp_t *l, lisp_cell_t *args)
@@ -28,17 +28,16 @@ static int ud_sql;
 #define X(NAME, SUBR, VALIDATION , DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, lisp_cell_t *args);
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t primitives[] = {
 	SUBROUTINE_XLIST		/*all of the subr functions */
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 
 static void ud_sql_free(lisp_cell_t * f)
 {
 	if (!is_closed(f))
 		sqlite3_close(get_user(f));
-	free(f);
 }
 
 static int ud_sql_print(io_t * o, unsigned depth, lisp_cell_t * f)
@@ -46,6 +45,16 @@ static int ud_sql_print(io_t * o, unsigned depth, lisp_cell_t * f)
 	return lisp_printf(NULL, o, depth, "%B<sql-database-handle:%d:%s>%t", get_user(f), is_closed(f) ? "closed" : "open");
 }
 
+/**@brief tell the collector how much memory a database handle is using*/
+static lisp_cell_t *sql_account(lisp_t * l, lisp_cell_t * f)
+{
+	int used = 0, highwater = 0;
+	if (!is_closed(f))
+		sqlite3_db_status(get_user(f), SQLITE_DBSTATUS_CACHE_USED, &used, &highwater, 0);
+	lisp_gc_account_external(l, f, used > 0 ? used : 0);
+	return f;
+}
+
 static lisp_cell_t *subr_sql_open(lisp_t * l, lisp_cell_t * args)
 {
 	sqlite3 *db;
@@ -54,7 +63,7 @@ static lisp_cell_t *subr_sql_open(lisp_t * l, lisp_cell_t * args)
 		sqlite3_close(db);
 		return gsym_error();
 	}
-	return mk_user(l, db, ud_sql);
+	return sql_account(l, mk_user(l, db, ud_sql));
 }
 
 static lisp_cell_t *subr_sql_close(lisp_t * l, lisp_cell_t * args)
@@ -63,6 +72,7 @@ static lisp_cell_t *subr_sql_close(lisp_t * l, lisp_cell_t * args)
 		LISP_RECOVER(l, "\"expected (sql-database)\" '%S", args);
 	sqlite3_close(get_user(car(args)));
 	close_cell(car(args));
+	sql_account(l, car(args));
 	return gsym_tee();
 }
 
@@ -98,7 +108,9 @@ static lisp_cell_t *subr_sql(lisp_t * l, lisp_cell_t * args)
 	cb.l   = l;
 	if (!lisp_check_length(args, 2) || !is_usertype(car(args), ud_sql) || !is_asciiz(CADR(args)))
 		LISP_RECOVER(l, "\"expected (sql-database string)\" '%S", args);
-	if ((rc = sqlite3_exec(get_user(car(args)), get_str(CADR(args)), sql_callback, &cb, &errmsg)) != SQLITE_OK) {
+	rc = sqlite3_exec(get_user(car(args)), get_str(CADR(args)), sql_callback, &cb, &errmsg);
+	sql_account(l, car(args));
+	if (rc != SQLITE_OK) {
 		lisp_cell_t *r;
 		r = mk_list(l, gsym_error(), mk_str(l, lisp_strdup(l, errmsg)), mk_int(l, rc), NULL);
 		sqlite3_free(errmsg);
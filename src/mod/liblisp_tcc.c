@@ -25,10 +25,10 @@
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
 
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(#SUBR, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(#SUBR, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t primitives[] = {
 	SUBROUTINE_XLIST	/*all of the subr functions */
-	{NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 #undef X
 
@@ -37,7 +37,6 @@ static int ud_tcc = 0;
 static void ud_tcc_free(lisp_cell_t * f)
 {
 	tcc_delete(get_user(f));
-	free(f);
 }
 
 static int ud_tcc_print(io_t * o, unsigned depth, lisp_cell_t * f)
@@ -27,10 +27,10 @@
 #define X(NAME, SUBR, VALIDATION, DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, lisp_cell_t *args);
 SUBROUTINE_XLIST		/*function prototypes for all of the built-in subroutines */
 #undef X
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static lisp_module_subroutines_t primitives[] = {
 	SUBROUTINE_XLIST		/*all of the subr functions */
-	{ NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
+	{ NULL, NULL, NULL, NULL, NULL}	/*must be terminated with NULLs */
 };
 #undef X
 
@@ -62,7 +62,7 @@ static lisp_cell_t *xml2lisp(lisp_t *l, mxml_node_t *node)
 				val = lisp_strdup(l, (t->value.element.attrs)[i].value);
 				keyc = mk_str(l, key);
 				valc = mk_str(l, val);
-				if(hash_insert(ht, key, cons(l, keyc, valc)) < 0)
+				if(hash_insert(ht, get_str(keyc), cons(l, keyc, valc)) < 0)
 					LISP_HALT(l, "\"%s\"", "out of memory");
 			}
 			hash = mk_hash(l, ht);
@@ -0,0 +1,219 @@
+/** @file       opt.c
+ *  @brief      Optimizations made to the code "compile" resolves
+ *  @author     Richard Howe (2015)
+ *  @license    LGPL v2.1 or Later
+ *  @email      howe.r.j.89@gmail.com
+ *
+ *  Once "compile" has resolved the variables in an expression, see
+ *  resolve() in eval.c, the expression is passed to lisp_optimize(), which:
+ *
+ *  - Calls primitives with no side effects, such as "+" or "car", that have
+ *    constant arguments and puts the result in place of the call.
+ *  - Puts the code of small procedures made with "compile" in place of
+ *    calls to them, if the arguments are constants or variables. The code
+ *    is only run if the variable is still bound to the procedure, so
+ *    redefining it is seen by its callers.
+ *  - Removes the branches of "if" and "cond" that cannot be taken.
+ *
+ *  Redefining a primitive does not change the calls to it that have been
+ *  folded, lisp_set_optimize() turns this off for debugging.
+ **/
+#include "liblisp.h"
+#include "private.h"
+#include <assert.h>
+#include <string.h>
+
+void lisp_set_optimize(lisp_t *l, int on) {
+	assert(l);
+	l->optimize_off = !on;
+}
+
+/**@brief does the expression "x" always evaluate to the same value?*/
+static int opt_is_constant(lisp_t *l, lisp_cell_t *x) {
+	if (is_nil(x) || x == l->tee)
+		return 1;
+	switch (cell_type(x)) {
+	case INTEGER:
+	case FLOAT:
+	case STRING:
+		return 1;
+	case CONS:
+		return car(x) == l->quote && is_cons(cdr(x));
+	default:
+		return 0;
+	}
+}
+
+/**@brief the value of a constant expression*/
+static lisp_cell_t *opt_value(lisp_t *l, lisp_cell_t *x) {
+	return is_cons(x) && car(x) == l->quote ? CADR(x) : x;
+}
+
+/**@brief the value of a global variable, if it is bound*/
+static lisp_cell_t *opt_global(lisp_t *l, lisp_cell_t *x) {
+	lisp_cell_t *binding;
+	size_t slot;
+	if (cell_type(x) != VARIABLE || variable_depth(x) != VARIABLE_GLOBAL)
+		return NULL;
+	binding = lisp_variable_lookup(l, x, l->nil, &slot);
+	return is_nil(binding) ? NULL : binding_value(binding, slot);
+}
+
+/**@brief call a pure primitive on constant arguments, errors are not
+ *	  reported here but when the code is run
+ * @return a constant expression or "exp" if it cannot be folded*/
+static lisp_cell_t *opt_fold(lisp_t *l, lisp_cell_t *f, lisp_cell_t *exp) {
+	lisp_cell_t *args, *ret;
+	const int log_level = l->log_level, errors_halt = l->errors_halt;
+	const size_t base = l->gc_stack_used;
+	volatile size_t argc = 0;
+	volatile int restore_used = 0;
+	int r;
+	jmp_buf restore;
+	for (args = cdr(exp); is_cons(args); args = cdr(args))
+		if (!opt_is_constant(l, car(args)))
+			return exp;
+	for (args = cdr(exp); is_cons(args); args = cdr(args), argc++)
+		lisp_gc_add(l, opt_value(l, car(args)));
+	if (l->recover_init) {
+		memcpy(restore, l->recover, sizeof(jmp_buf));
+		restore_used = 1;
+	}
+	if ((r = setjmp(l->recover))) {
+		LISP_RECOVER_RESTORE(restore_used, l, restore);
+		l->gc_stack_used = base;
+		l->log_level = log_level;
+		l->errors_halt = errors_halt;
+		if (r < 0) /*halting is not an error in the code*/
+			lisp_throw(l, r);
+		return exp;
+	}
+	l->recover_init = 1;
+	l->log_level = LISP_LOG_LEVEL_OFF;
+	l->errors_halt = 0;
+	ret = lisp_subr_call(l, f, base, argc);
+	LISP_RECOVER_RESTORE(restore_used, l, restore);
+	l->gc_stack_used = base; /*the arguments are no longer needed*/
+	lisp_gc_add(l, ret);
+	l->log_level = log_level;
+	l->errors_halt = errors_halt;
+	if (!is_nil(ret) && ret != l->tee && (is_sym(ret) || is_cons(ret)))
+		return mk_list(l, l->quote, ret, NULL);
+	return ret;
+}
+
+/**@brief can the code of "f", with "n" arguments, be put in place of a
+ *	  call to it? It must not bind variables or refer to any variables
+ *	  apart from its arguments and bound globals, nor call itself.*/
+static int opt_inlinable(lisp_t *l, lisp_cell_t *f, lisp_cell_t *x, size_t n, size_t *size) {
+	if (++*size > MAX_INLINE_SIZE)
+		return 0;
+	if (cell_type(x) == VARIABLE) {
+		lisp_cell_t *g, *params = get_proc_args(f);
+		if (variable_depth(x) == VARIABLE_GLOBAL)
+			return (g = opt_global(l, x)) && g != f;
+		if ((size_t)variable_depth(x) >= n)
+			return 0;
+		for (size_t i = n - 1 - variable_depth(x); i; i--)
+			params = cdr(params);
+		return car(params) == variable_symbol(x);
+	}
+	if (is_sym(x))
+		return lisp_is_special(l, x) && x != l->lambda && x != l->flambda && x != l->compile
+			&& x != l->let && x != l->define && x != l->setq && x != l->macro;
+	if (!is_cons(x) || car(x) == l->quote)
+		return 1;
+	for (; is_cons(x); x = cdr(x))
+		if (!opt_inlinable(l, f, car(x), n, size))
+			return 0;
+	return is_nil(x);
+}
+
+static lisp_cell_t *opt(lisp_t *l, lisp_cell_t *exp, int inlining);
+
+/**@brief copy the code of a procedure, replacing its "n" arguments with
+ *	  the expressions in "args" and optimizing the copy*/
+static lisp_cell_t *opt_substitute(lisp_t *l, lisp_cell_t *x, lisp_cell_t *args, size_t n) {
+	lisp_cell_t *head, *op;
+	if (cell_type(x) == VARIABLE && variable_depth(x) != VARIABLE_GLOBAL) {
+		for (size_t i = n - 1 - variable_depth(x); i; i--)
+			args = cdr(args);
+		return car(args);
+	}
+	if (!is_cons(x) || car(x) == l->quote)
+		return x;
+	head = op = cons(l, l->nil, l->nil);
+	for (; is_cons(x); x = cdr(x), op = cdr(op))
+		set_cdr(op, cons(l, opt_substitute(l, car(x), args, n), l->nil));
+	return opt(l, cdr(head), 0);
+}
+
+/**@brief put the code of a procedure made by "compile" in place of a
+ *	  call to it, the arguments must be constants or variables as they
+ *	  may be evaluated any number of times. The code is guarded with
+ *	  (if (eq variable 'procedure) code call) in case the variable is
+ *	  given a new value.
+ * @return the new code or NULL if the call cannot be inlined*/
+static lisp_cell_t *opt_inline(lisp_t *l, lisp_cell_t *f, lisp_cell_t *exp) {
+	lisp_cell_t *params = get_proc_args(f), *code = get_proc_code(f), *args = cdr(exp);
+	size_t n = 0, size = 0;
+	if (!f->bytecode || !is_cons(code) || !is_nil(cdr(code)))
+		return NULL;
+	for (; is_cons(params) && is_cons(args); params = cdr(params), args = cdr(args), n++)
+		if (!opt_is_constant(l, car(args)) && cell_type(car(args)) != VARIABLE)
+			return NULL;
+	if (!is_nil(params) || !is_nil(args) || !opt_inlinable(l, f, car(code), n, &size))
+		return NULL;
+	return mk_list(l, l->iif, mk_list(l, l->eq, car(exp), mk_list(l, l->quote, f, NULL), NULL),
+			opt_substitute(l, car(code), cdr(exp), n), exp, NULL);
+}
+
+/**@brief remove an "if" whose test is constant*/
+static lisp_cell_t *opt_if(lisp_t *l, lisp_cell_t *exp) {
+	if (!lisp_check_length(exp, 4) || !opt_is_constant(l, CADR(exp)))
+		return exp;
+	return is_nil(opt_value(l, CADR(exp))) ? CADDDR(exp) : CADDR(exp);
+}
+
+/**@brief remove the clauses of a "cond" that cannot be reached*/
+static lisp_cell_t *opt_cond(lisp_t *l, lisp_cell_t *exp) {
+	lisp_cell_t *head = cons(l, l->cond, l->nil), *op = head, *c;
+	for (exp = cdr(exp); is_cons(exp); exp = cdr(exp)) {
+		c = car(exp);
+		if (is_cons(c) && is_cons(cdr(c)) && opt_is_constant(l, car(c))) {
+			if (is_nil(opt_value(l, car(c))))
+				continue; /*never taken*/
+			if (op == head)
+				return CADR(c);
+			set_cdr(op, cons(l, c, l->nil));
+			return head; /*always taken, the rest are never reached*/
+		}
+		set_cdr(op, cons(l, c, l->nil));
+		op = cdr(op);
+		if (!is_cons(c)) /*"cond" stops here*/
+			break;
+	}
+	return op == head ? l->nil : head;
+}
+
+static lisp_cell_t *opt(lisp_t *l, lisp_cell_t *exp, int inlining) {
+	lisp_cell_t *f, *x;
+	if (l->optimize_off || !is_cons(exp))
+		return exp;
+	if (car(exp) == l->iif)
+		return opt_if(l, exp);
+	if (car(exp) == l->cond)
+		return opt_cond(l, exp);
+	if (!(f = opt_global(l, car(exp))) || !is_proper_cons(exp))
+		return exp;
+	if (is_subr(f) && f->pure)
+		return opt_fold(l, f, exp);
+	if (inlining && is_proc(f) && (x = opt_inline(l, f, exp)))
+		return x;
+	return exp;
+}
+
+lisp_cell_t *lisp_optimize(lisp_t *l, lisp_cell_t *exp) {
+	assert(l && exp);
+	return opt(l, exp, 1);
+}
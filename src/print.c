@@ -202,7 +202,7 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth) {
 		lisp_log_error(l, "%r'print-depth-exceeded %d%t", (intptr_t) depth);
 		return -1;
 	}
-	switch (op->type) {
+	switch (cell_type(op)) {
 	case INTEGER:
 		lisp_printf(l, o, depth, "%m%d", get_int(op));
 		break;
@@ -212,13 +212,13 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth) {
 	case CONS:
 		if (depth && o->pretty)
 			lisp_printf(l, o, depth, "\n%@ ");
-		if (op->mark) {
-			op->mark = 0;
+		if (op->visit) {
+			op->visit = 0;
 			lisp_printf(l, o, depth, "%g<recurse:%d>%t", (intptr_t)op);
 			return 0;
 		}
 		tmp = op;
-		op->mark = 1;
+		op->visit = 1;
 		io_putc('(', o);
 		for (;;) {
 			printer(l, o, car(op), depth + 1);
@@ -227,7 +227,7 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth) {
 				break;
 			}
 			op = cdr(op);
-			if (op->mark) {
+			if (is_cons(op) && op->visit) {
 				lisp_printf(l, o, depth, "%g <recurse:%d>%t)", (intptr_t)op);
 				break;
 			}
@@ -237,7 +237,7 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth) {
 			}
 			io_putc(' ', o);
 		}
-		tmp->mark = 0;
+		tmp->visit = 0;
 		break;
 	case SYMBOL:
 		if (is_nil(op)) lisp_printf(l, o, depth, "%rnil");
@@ -269,6 +269,15 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth) {
 			op->close? "closed" :
 				(is_in(op)? "in" : "out"), get_int(op));
 		break;
+	case WEAK:
+		lisp_printf(l, o, depth, "%B<weak:%d>", (intptr_t)get_weak(op));
+		break;
+	case FRAME:
+		lisp_printf(l, o, depth, "%B<frame:%d>", (intptr_t)frame_count(op));
+		break;
+	case VARIABLE: /*printed as the symbol it was made from*/
+		lisp_printf(l, o, depth, "%y%s", get_sym(variable_symbol(op)));
+		break;
 	case USERDEF:
 		if (l && l->ufuncs[get_user_type(op)].print)
 			(l->ufuncs[get_user_type(op)].print)(o, depth, op);
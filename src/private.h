@@ -22,19 +22,72 @@ extern "C" {
 #define DEFAULT_LEN       (256)   /**< just an arbitrary number*/
 #define LARGE_DEFAULT_LEN (4096)  /**< just another arbitrary number*/
 #define MAX_USER_TYPES    (256)   /**< max number of user defined types*/
-#define COLLECTION_POINT  (1<<20) /**< run gc after this many allocs*/
+#define MAX_INLINE_SIZE   (32)    /**< largest procedure "compile" inlines, in cells of code*/
+#define GC_GROWTH_FACTOR  (2.0)   /**< default heap growth between collections*/
+#define GC_MIN_HEAP       (1<<24) /**< default heap size to collect at in bytes*/
+#define GC_MAX_HEAP       (0)     /**< default largest heap size, 0 for no limit*/
+#define GC_MINOR_COLLECTIONS (8)  /**< minor collections between full ones*/
+#define GC_SLICE_PERIOD   (1024)  /**< allocations between incremental marking slices*/
+#define GC_PAGE_SIZE      (1<<16) /**< size of a page of cells in bytes*/
+#define GC_SIZE_CLASSES   (6)     /**< number of different cell sizes*/
+#define GC_MAX_FIELDS     (16)    /**< fields in the cells of the largest size class*/
+#define GC_GRAIN          (sizeof(void*)) /**< granularity of mark bits*/
+#define GC_MARK_WORDS     (GC_PAGE_SIZE / GC_GRAIN / 64) /**< mark bitmap size*/
+#define GC_PARALLEL_HEAP  (1<<26) /**< smallest heap in bytes marked in parallel*/
+#define GC_HASH_CHUNK     (256)   /**< hash bins marked as one unit of parallel work*/
+#define GC_WORK_CHUNK     (64)    /**< marking work shared with idle threads at once*/
 #define BITS_IN_LENGTH    (32)    /**< number of bits in a length field*/
+#define STRING_INLINE_LEN (3*sizeof(cell_data_t) - 1) /**< longest string kept inside its cell*/
 #define MAX_RECURSION_DEPTH (4096) /**< maximum recursion depth*/
 
 /**@warning the following list must be kept in sync with the
  * gsym_X functions defined in there liblisp.h header (such as gsym_nil,
  * gsym_tee or gsym_error). */
 #define CELL_XLIST /**< list of all special cells for initializer*/ \
-	X(nil,     "nil")     X(tee,     "t")      X(quote,   "quote")\
-	X(iif,     "if")      X(lambda,  "lambda") X(flambda, "flambda")\
-	X(define,  "define")  X(setq,    "setq")   X(progn,   "progn")\
-	X(cond,    "cond")    X(error,   "error")  X(let,     "let")\
-       	X(compile, "compile") X(macro,   "macro")  X(dowhile, "while")\
+	X(nil,     "nil",     NONE)    X(tee,     "t",      NONE)\
+	X(quote,   "quote",   QUOTE)   X(iif,     "if",     IF)\
+	X(lambda,  "lambda",  LAMBDA)  X(flambda, "flambda", FLAMBDA)\
+	X(define,  "define",  DEFINE)  X(setq,    "setq",   SETQ)\
+	X(progn,   "progn",   PROGN)   X(cond,    "cond",   COND)\
+	X(error,   "error",   NONE)    X(let,     "let",    LET)\
+	X(compile, "compile", COMPILE) X(macro,   "macro",  MACRO)\
+	X(dowhile, "while",   WHILE)\
+
+/**@brief The special forms eval() handles itself, the symbols in CELL_XLIST
+ *        that name one have it in the "form" field of their cell, so a
+ *        single switch finds the form a list is, if any.*/
+typedef enum {
+	FORM_NONE,    /**< not a special form, a procedure call*/
+	FORM_QUOTE,   /**< (quote expr)*/
+	FORM_IF,      /**< (if test then else)*/
+	FORM_LAMBDA,  /**< (lambda docstring? (args) code...)*/
+	FORM_FLAMBDA, /**< (flambda docstring? (arg) code...)*/
+	FORM_DEFINE,  /**< (define symbol expr)*/
+	FORM_SETQ,    /**< (setq symbol expr)*/
+	FORM_PROGN,   /**< (progn expr...)*/
+	FORM_COND,    /**< (cond (test expr)...)*/
+	FORM_LET,     /**< (let (symbol expr)... expr)*/
+	FORM_COMPILE, /**< (compile docstring (args) expr)*/
+	FORM_MACRO,   /**< (macro ...), not implemented*/
+	FORM_WHILE    /**< (while test expr...)*/
+} lisp_form;
+
+/**@brief The arithmetic some built in primitives do, which the evaluator
+ *        and the virtual machine do inline when they are called on two
+ *        numbers, see lisp_arith(). The primitives have
+ *        it in the "arith" field of their cell, so a primitive bound in
+ *        their place is called as normal.*/
+typedef enum {
+	ARITH_NONE,    /**< not done inline*/
+	ARITH_ADD,     /**< "+"*/
+	ARITH_SUB,     /**< "-"*/
+	ARITH_MUL,     /**< "*"*/
+	ARITH_DIV,     /**< "/"*/
+	ARITH_MOD,     /**< "%"*/
+	ARITH_LESS,    /**< "<"*/
+	ARITH_GREATER, /**< ">"*/
+	ARITH_EQUAL    /**< "="*/
+} lisp_arith_op;
 
 /**@brief This restores a jmp_buf stored in lisp environment if it
  *	has been copied out to make way for another jmp_buf.
@@ -60,7 +113,10 @@ typedef enum {
 	FPROC,   /**< F-Expression*/
 /*	MACRO,   // Macro */
 	FLOAT,   /**< Floating point number; could be float or double*/
-	USERDEF  /**< User defined types*/
+	USERDEF, /**< User defined types*/
+	WEAK,    /**< Weak reference to another object*/
+	VARIABLE,/**< Variable reference made by "compile"*/
+	FRAME    /**< Bindings made by a procedure call or "let"*/
 	/**@todo CLOSURE, MACRO (replaces FPROC), VECTORs (array of same type, strings really
 	 * should be a vector of chars). */
 } lisp_type;     /**< A lisp object*/
@@ -70,6 +126,7 @@ typedef union { /**< ideally we would use void* for everything*/
 	lisp_float_t f;    /**< if lisp_float_t is double it could be bigger than *v */
 	lisp_subr_func prim;   /**< function pointers are not guaranteed
 	                                              to fit into a void**/
+	lisp_subr_vector_func vprim; /**< a primitive taking an array of arguments*/
 } cell_data_t; /**< a union of all the different C datatypes used*/
 
 /**@brief A tagged object representing all possible lisp data types.
@@ -86,16 +143,72 @@ typedef union { /**< ideally we would use void* for everything*/
  * The cell uses the "struct hack", see
  * <http://c-faq.com/struct/structhack.html> **/
 struct cell {
-	/**@todo look at optimizing these fields, also add weak references*/
+	/**@todo look at optimizing these fields*/
 	unsigned type:   4,        /**< Type of the lisp object*/
-		mark:    1,        /**< mark for garbage collection*/
+		visit:   1,        /**< used by the printer to detect cycles*/
 		uncollectable: 1,  /**< do not free object?*/
 		close:   1,        /**< object closed/invalid?*/
-		used:    1; /**< object is in use by something outside lisp interpreter*/
+		used:    1, /**< object is in use by something outside lisp interpreter*/
+		weak_keys:   1, /**< hash entries are removed when their key is collected*/
+		weak_values: 1, /**< hash entries are removed when their value is collected*/
+		bytecode: 1, /**< run a procedure with the virtual machine, see vm.c*/
+		pure:     1, /**< a primitive "compile" may call on constant arguments, see opt.c*/
+		vector:   1, /**< a primitive taking an array of arguments, see mk_subr_vector()*/
+		arith:    4, /**< the arithmetic a built in primitive does, see lisp_arith_op*/
+		form:     4; /**< the special form a symbol names, see lisp_form*/
 	cell_data_t p[1]; /**< uses the "struct hack",
 	                     c99 does not quite work here*/
 } /*__attribute__((packed)) <- saves a bit of space */;
 
+/* Integers that fit in a pointer less one bit are not allocated, they are
+ * stored in the pointer itself with the lowest bit set (a "fixnum"). Cells
+ * are always aligned so no pointer to a real cell has this bit set, which
+ * means a pointer must be checked with is_fixnum() before any field of the
+ * cell it points to is used. Larger integers are normal INTEGER cells.*/
+#define FIXNUM_TAG    ((uintptr_t)1) /**< bit set in a pointer holding an integer*/
+#define FIXNUM_MIN    (INTPTR_MIN / 2) /**< smallest integer held in a pointer*/
+#define FIXNUM_MAX    (INTPTR_MAX / 2) /**< largest integer held in a pointer*/
+#define is_fixnum(X)  ((uintptr_t)(X) & FIXNUM_TAG) /**< is X an integer held in a pointer?*/
+#define cell_type(X)  (is_fixnum(X) ? INTEGER : (X)->type) /**< lisp_type of any object*/
+#define cell_form(X)  (is_fixnum(X) ? FORM_NONE : (lisp_form)(X)->form) /**< special form any object names*/
+
+/* "compile" replaces the variables in the code it is given with VARIABLE
+ * cells. These hold the symbol and the number of bindings in front of the
+ * one it refers to in the environment the code will be run in, or for a
+ * top level variable VARIABLE_GLOBAL and its binding in the top level hash
+ * (or nil if it was not defined when the code was compiled).*/
+#define VARIABLE_GLOBAL     (-1) /**< depth of a VARIABLE for a top level variable*/
+#define variable_symbol(X)  ((lisp_cell_t*)((X)->p[0].v)) /**< name of a VARIABLE*/
+#define variable_depth(X)   ((intptr_t)((X)->p[1].v)) /**< bindings to skip to find a VARIABLE*/
+#define variable_binding(X) ((lisp_cell_t*)((X)->p[2].v)) /**< top level binding of a VARIABLE*/
+
+/* An environment is a list of bindings, each a cons of a symbol and its
+ * value, and of hashes of such bindings. Procedure calls and "let" put
+ * FRAMEs in front of it instead, which hold the values of all of the
+ * bindings they make in one cell along with the symbols they are bound to
+ * (a list of them, which may be dotted, or a single symbol) and the rest of
+ * the environment. The last binding of a FRAME is the one in front of the
+ * others. A binding is found with lisp_env_lookup(), which gives the cell
+ * and field its value is in, field 1 (the cdr) of a cons or one of the
+ * value fields of a FRAME.*/
+#define FRAME_VALUES        (3) /**< field of the first value of a FRAME*/
+#define FRAME_MAX           (GC_MAX_FIELDS - FRAME_VALUES) /**< most bindings a FRAME holds*/
+#define is_frame(X)         (cell_type(X) == FRAME) /**< is X a FRAME?*/
+#define frame_parent(X)     ((lisp_cell_t*)((X)->p[0].v)) /**< environment behind a FRAME*/
+#define frame_symbols(X)    ((lisp_cell_t*)((X)->p[1].v)) /**< symbols a FRAME binds*/
+#define frame_count(X)      ((size_t)((X)->p[2].v)) /**< number of bindings in a FRAME*/
+#define env_next(X)         (is_frame(X) ? frame_parent(X) : cdr(X)) /**< rest of an environment*/
+#define binding_value(B, S) ((lisp_cell_t*)((B)->p[(S)].v)) /**< value of a binding*/
+
+/* A SUBR holds its function, its format string, its documentation and the
+ * number of arguments the format string describes. The format string is
+ * compiled by lisp_validate_compile() when the SUBR is made, into a code
+ * for each argument stored in the fields after these, so checking the
+ * arguments of a call does not parse it again.*/
+#define SUBR_CODES          (4) /**< field the validation codes of a SUBR start in*/
+#define SUBR_MAX_ARGS       ((GC_MAX_FIELDS - SUBR_CODES) * sizeof(cell_data_t)) /**< most arguments a format string can describe*/
+#define subr_codes(X)       ((unsigned char*)&((X)->p[SUBR_CODES])) /**< validation codes of a SUBR*/
+
 /** @brief This describes an entry in a hash table, which is an
  *	 implementation detail of the hash, so should not be
  *	 counted upon. It represents a node in a chained hash
@@ -156,11 +269,42 @@ struct tr_state {
 		previous_char; /**< previous translation char, for squeeze*/
 };
 
-/** @brief Type used to form linked list of all allocations */
-typedef struct gc_list {
-	lisp_cell_t *ref; /**< reference to cell for the garbage collector to act on*/
-	struct gc_list *next; /**< next in list*/
-} gc_list_t;
+/** @brief A page of equally sized cells, cells are handed out from the
+ *	 free list threaded through the unused cells of a page and the
+ *	 sweeper walks each page linearly. Free cells have the INVALID
+ *	 type and use their first field to point to the next free cell.
+ *
+ *	 Pages are aligned on a GC_PAGE_SIZE boundary so the page a cell
+ *	 belongs to can be found by masking its address. The mark bits
+ *	 for the cells are kept in a bitmap in the page header, one bit
+ *	 per GC_GRAIN bytes of the page, so marking does not write to the
+ *	 cells themselves. Uncollectable cells are never marked.
+ *
+ *	 The collector is generational without moving any cells, the
+ *	 mark bits are left set after a collection so a set mark means a
+ *	 cell is old, minor collections stop tracing when they reach an old
+ *	 cell. Old cells that have a cell stored in them are recorded in
+ *	 the remembered bitmap by lisp_gc_write_barrier(). Cells past "bump"
+ *	 have never been allocated, new pages are bump allocated.
+ *
+ *	 Sweeping is lazy, after marking only the live cells of each page
+ *	 are counted and the page is marked as unswept. The dead cells of a
+ *	 page are freed when the allocator next wants a cell from it, or by
+ *	 a background thread if the collector has threads to use. Pages with
+ *	 cells that hold memory outside the heap are swept at once.*/
+typedef struct gc_page {
+	struct gc_page *next; /**< next page in the same size class*/
+	lisp_cell_t *free;    /**< list of free cells in this page*/
+	size_t cell_size,     /**< size of each cell in bytes*/
+	       cells,         /**< number of cells in this page*/
+	       used,          /**< number of cells allocated*/
+	       bump;          /**< cells handed out from the end of page*/
+	size_t external;      /**< bytes held outside the heap by the page's cells*/
+	int dirty,            /**< is anything set in "remembered"?*/
+	    swept;            /**< state of sweeping, see gc.c*/
+	uint64_t marks[GC_MARK_WORDS], /**< mark bitmap for the cells*/
+		remembered[GC_MARK_WORDS]; /**< old cells written to*/
+} gc_page_t;
 
 /** @brief functions the interpreter uses for user defined types */
 typedef struct {
@@ -177,7 +321,7 @@ typedef struct {
  *	 to run a complete lisp environment. */
 struct lisp {
 	jmp_buf recover; /**< longjmp when there is an error */
-#define X(CNAME, LNAME) * CNAME,
+#define X(CNAME, LNAME, FORM) * CNAME,
 	lisp_cell_t CELL_XLIST Unused; /**< list of special forms/symbols*/
 #undef X
 	lisp_cell_t *all_symbols, /**< all intern'ed symbols*/
@@ -188,15 +332,48 @@ struct lisp {
 		*logging,     /**< interpreter logging/error stream*/
 		*cur_env,     /**< current interpreter depth*/
 		*empty_docstr,/**< empty doc string */
-		**gc_stack;   /**< garbage collection stack for working items*/
-	gc_list_t *gc_head;   /**< linked list of all allocated objects*/
+		*eq,          /**< the built in "eq", which guards inlined code*/
+		**gc_stack,   /**< garbage collection stack for working items*/
+		**gc_gray,    /**< cells marked but whose children are not*/
+		**gc_weak;    /**< weak references and weak hashes*/
+	gc_page_t *gc_pages[GC_SIZE_CLASSES],  /**< pages for each cell size*/
+		*gc_cursor[GC_SIZE_CLASSES]; /**< first page to allocate from*/
 	char *token    /**< one token of put back for parser*/,
 		*buf   /**< input buffer for parser*/;
 	size_t buf_allocated,/**< size of buffer "l->buf"*/
 		buf_used,     /**< amount of buffer used by current string*/
 		gc_stack_allocated, /**< length of buffer of GC stack*/
 		gc_stack_used,      /**< elements used in GC stack*/
-		gc_collectp;  /**< garbage collect after it goes too high*/
+		gc_collectp,  /**< allocations, used to schedule marking slices*/
+		gc_heap,      /**< bytes of cells currently allocated*/
+		gc_threshold, /**< collect when "gc_heap" reaches this*/
+		gc_min_heap,  /**< smallest value for "gc_threshold"*/
+		gc_max_heap,  /**< largest value for "gc_threshold", or 0*/
+		gc_quota,     /**< most bytes the interpreter may use, or 0*/
+		gc_owned,     /**< estimate of bytes held outside of cells*/
+		gc_external,  /**< bytes held by user defined types outside of cells*/
+		gc_allocations, /**< total cells allocated*/
+		gc_collections, /**< total collections performed*/
+		gc_major_collections, /**< total full collections performed*/
+		gc_stack_max, /**< high water mark of "gc_stack_used"*/
+		gc_page_count, /**< number of pages allocated*/
+		gc_minor_collections, /**< minor collections since a full one*/
+		gc_weak_allocated,  /**< length of buffer of weak objects*/
+		gc_weak_used,       /**< elements used in weak objects*/
+		gc_gray_allocated,  /**< length of buffer of gray list*/
+		gc_gray_used,       /**< elements used in gray list*/
+		gc_gray_max,        /**< most elements the gray list may grow to, or 0*/
+		gc_parallel_heap,   /**< smallest heap marked and swept by several threads*/
+		gc_budget_cells;    /**< cells to mark per incremental slice*/
+	unsigned long gc_budget_usecs; /**< time limit of each marking slice*/
+	unsigned gc_threads; /**< threads to collect with, if compiled with USE_THREADS*/
+	void *gc_sweeper;    /**< background sweeper thread, if one is running*/
+	double gc_growth,   /**< heap growth factor after a collection*/
+		gc_survival, /**< fraction of the heap that survived the last collection*/
+		gc_pause,    /**< longest pause of the last collection, seconds*/
+		gc_cycle_pause, /**< longest pause of the current collection*/
+		gc_pause_total, /**< time spent in all collections*/
+		gc_pause_max;   /**< longest pause of any collection*/
 	lisp_editor_func editor; /**< line editor to use, optional*/
 	lisp_user_defined_funcs_t ufuncs[MAX_USER_TYPES]; /**< for user defined types*/
 	int user_defined_types_used;   /**< number of user defined types allocated*/
@@ -208,6 +385,11 @@ struct lisp {
 		color_on:     1, /**< REPL Colorize output*/
 		prompt_on:    1, /**< REPL '>' Turn prompt on*/
 		gc_off:       1, /**< turn the garbage collector off*/
+		gc_marking:   1, /**< incremental marking in progress?*/
+		gc_marking_major: 1, /**< is it a full collection?*/
+		gc_gray_overflow: 1, /**< could the gray list not grow?*/
+		gc_compact:   1, /**< release empty pages and fill dense ones first*/
+		optimize_off: 1, /**< do not optimize the code "compile" makes*/
 		editor_on:    1; /**< REPL Turn the line editor on*/
 	unsigned cur_depth; /**< current recursion depth of the interpreter*/
 };
@@ -223,11 +405,51 @@ struct lisp {
  * @return cell* the added cell, or NULL when an internal allocation failed**/
 lisp_cell_t *lisp_gc_add(lisp_t *l, lisp_cell_t *op);
 
+/**@brief  Allocate a new, zeroed, cell from the pages of the size class
+ *	 that can hold "count" fields, the cell is owned by the collector.
+ * @param  l     the lisp environment to allocate in
+ * @param  count number of fields (cell_data_t) needed, 1 to GC_MAX_FIELDS
+ * @return cell* a new cell, this function throws on allocation failure**/
+lisp_cell_t *lisp_gc_alloc(lisp_t *l, size_t count);
+
+/**@brief Make sure "bytes" more can be allocated without going over the
+ *	quota set by lisp_gc_set_quota(), garbage is collected if they would
+ *	not fit and a recoverable error is thrown if they still do not.
+ * @param l      the lisp environment that is allocating
+ * @param bytes  number of bytes about to be allocated**/
+void lisp_gc_reserve(lisp_t *l, size_t bytes);
+
+/**@brief Tell the collector about a weak reference or weak hash, after each
+ *	collection it clears the references to objects that were collected
+ *	and removes the entries of weak hashes that refer to them.
+ * @param l      the lisp environment the object belongs to
+ * @param x      a WEAK or HASH object**/
+void lisp_gc_weak(lisp_t *l, lisp_cell_t *x);
+
+/**@brief Perform a collection when the allocator decides it is needed,
+ *	this is normally a minor collection of the young generation and
+ *	every GC_MINOR_COLLECTIONS collections it is a full collection. If
+ *	a budget has been set with lisp_gc_set_budget() this only starts
+ *	the marking, which is then done a slice at a time.
+ * @param l      the lisp environment to collect garbage in**/
+void lisp_gc_collect(lisp_t *l);
+
+/**@brief Perform one slice of incremental marking if there is a
+ *	collection in progress, this finishes the collection when there
+ *	is nothing left to mark.
+ * @param l      the lisp environment to collect garbage in**/
+void lisp_gc_slice(lisp_t *l);
+
 /**@brief This only performs a sweep, no objects are marked, this effectively
  *	invalidates the lisp environment!
  * @param l      the lisp environment to sweep and invalidate**/
 void lisp_gc_sweep_only(lisp_t *l);
 
+/**@brief Release all of the pages used to hold cells, this should only be
+ *	called after lisp_gc_sweep_only() when destroying an environment.
+ * @param l      the lisp environment to release the pages of**/
+void lisp_gc_release(lisp_t *l);
+
 /**@brief Read in a lisp expression
  * @param l      a lisp environment
  * @param i      the input port
@@ -250,12 +472,151 @@ int printer(lisp_t *l, io_t *o, lisp_cell_t *op, unsigned depth);
  * @return cell*  the evaluated expression **/
 lisp_cell_t *eval(lisp_t *l, unsigned depth, lisp_cell_t *exp, lisp_cell_t *env);
 
-/**@brief  find a key in an association list (a-list)
+/**@brief  find a key in an association list (a-list), which may end in
+ *	   an environment made of FRAMEs, see lisp_env_lookup()
+ * @param  l      the lisp environment, a binding in a FRAME is returned
+ *	   as a new cons
  * @param  key    key to search for
  * @param  alist  association list
  * @return if key is found it returns a cons of the key and the associated
  *	 value, if not found it returns nil**/
-lisp_cell_t *lisp_assoc(lisp_cell_t *key, lisp_cell_t *alist);
+lisp_cell_t *lisp_assoc(lisp_t *l, lisp_cell_t *key, lisp_cell_t *alist);
+
+/**@brief  Find the binding of a symbol in an environment, see FRAME.
+ * @param  key  symbol to search for
+ * @param  env  the environment to search in
+ * @param  slot set to the field of the binding that holds its value
+ * @return the cons or FRAME holding the binding, or nil if it is unbound**/
+lisp_cell_t *lisp_env_lookup(lisp_cell_t *key, lisp_cell_t *env, size_t *slot);
+
+/**@brief  Change the value of a binding found by lisp_env_lookup()
+ * @param  binding the cons or FRAME holding the binding
+ * @param  slot    the field of the binding that holds its value
+ * @param  val     the new value**/
+void lisp_binding_set(lisp_cell_t *binding, size_t slot, lisp_cell_t *val);
+
+/**@brief  Get the symbol bound by a binding of a FRAME
+ * @param  frame the FRAME
+ * @param  i     the binding, 0 for the first symbol it binds
+ * @return the symbol**/
+lisp_cell_t *lisp_frame_symbol(lisp_cell_t *frame, size_t i);
+
+/**@brief  Make a FRAME that binds the symbol "sym" to nil in front of "env",
+ *         as "let" does before it evaluates the value of a binding.
+ * @param  l   the lisp environment
+ * @param  env the environment to extend
+ * @param  sym the symbol to bind
+ * @return the new environment**/
+lisp_cell_t *lisp_extend_frame(lisp_t *l, lisp_cell_t *env, lisp_cell_t *sym);
+
+/**@brief  Is "x" one of the special symbols, such as "if" or "nil"? These
+ *         are bound to themselves and eval() looks for some of them at the
+ *         start of the lists it is given, so "compile" leaves them alone.
+ * @param  l   the lisp environment
+ * @param  x   the object to check
+ * @return non zero if "x" is a special symbol**/
+int lisp_is_special(lisp_t *l, lisp_cell_t *x);
+
+/**@brief  Look up the binding of a VARIABLE made by "compile". The
+ *         environment should be the one the variable was resolved against,
+ *         if it is not the variable is looked up by its name instead.
+ * @param  l   the lisp environment
+ * @param  var the VARIABLE to look up
+ * @param  env the environment the code is being evaluated in
+ * @param  slot set to the field of the binding that holds its value
+ * @return the binding, as lisp_env_lookup() returns, or nil if the
+ *         variable is unbound**/
+lisp_cell_t *lisp_variable_lookup(lisp_t *l, lisp_cell_t *var, lisp_cell_t *env, size_t *slot);
+
+/**@brief  Bind the arguments of a procedure to the values it was called
+ *         with in a FRAME, in front of the environment it captured.
+ * @param  l    the lisp environment
+ * @param  proc the procedure or F-Expression being called
+ * @param  vals the list of values to bind
+ * @return the environment to evaluate the code of the procedure in**/
+lisp_cell_t *lisp_function_args(lisp_t *l, lisp_cell_t *proc, lisp_cell_t *vals);
+
+/**@brief  Bind the arguments of a procedure to values on the garbage
+ *         collection stack, which procedure calls use as an argument
+ *         stack, as lisp_function_args() binds them from a list.
+ * @param  l    the lisp environment
+ * @param  proc the procedure being called
+ * @param  args index of the first argument on the garbage collection stack
+ * @param  argc number of arguments
+ * @return the environment to evaluate the code of the procedure in**/
+lisp_cell_t *lisp_function_frame(lisp_t *l, lisp_cell_t *proc, size_t args, size_t argc);
+
+/**@brief  Call a primitive on arguments on the garbage collection
+ *         stack, after checking them against its format string. They are
+ *         copied into an array for one made with mk_subr_vector(), or a
+ *         list for one made with mk_subr().
+ * @param  l    the lisp environment
+ * @param  subr the primitive being called
+ * @param  args index of the first argument on the garbage collection stack
+ * @param  argc number of arguments
+ * @return the value the primitive returns**/
+lisp_cell_t *lisp_subr_call(lisp_t *l, lisp_cell_t *subr, size_t args, size_t argc);
+
+/**@brief  Do the arithmetic of a built in primitive inline, when it is
+ *         called on two numbers and cannot fail.
+ * @param  l the lisp environment
+ * @param  f the primitive being called, see lisp_arith_op
+ * @param  x the first argument
+ * @param  y the second argument
+ * @return the result, or NULL if "f" must be called instead**/
+lisp_cell_t *lisp_arith(lisp_t *l, lisp_cell_t *f, lisp_cell_t *x, lisp_cell_t *y);
+
+/**@brief  Make a list out of an array of arguments, for the error
+ *         messages of primitives made with mk_subr_vector().
+ * @param  l    the lisp environment
+ * @param  argc number of arguments
+ * @param  argv the arguments
+ * @return a new list**/
+lisp_cell_t *lisp_args_list(lisp_t *l, size_t argc, lisp_cell_t **argv);
+
+/**@brief  Compile a format string, as lisp_validate_args() takes, into a
+ *         code for each argument, which lisp_validate_cell() and
+ *         lisp_validate_vector() check primitives' arguments against.
+ * @param  fmt   the format string
+ * @param  codes the array to put the codes in
+ * @param  len   number of arguments "fmt" describes
+ * @return zero on success, negative if "fmt" is invalid**/
+int lisp_validate_compile(const char *fmt, unsigned char *codes, size_t len);
+
+/**@brief  Check an array of arguments against the format string of a
+ *         primitive, as lisp_validate_cell() checks a list of them.
+ * @param  l       the lisp environment
+ * @param  x       the primitive being called
+ * @param  argc    number of arguments
+ * @param  argv    the arguments
+ * @param  recover if non zero an invalid argument throws an error
+ * @return non zero if the arguments are valid**/
+int lisp_validate_vector(lisp_t *l, lisp_cell_t *x, size_t argc, lisp_cell_t **argv, int recover);
+
+/**@brief  Evaluate the code of a procedure as "progn" would, without
+ *         making a list to evaluate.
+ * @param  l     the lisp environment
+ * @param  depth current evaluation depth, not to exceed a limit
+ * @param  code  the list of expressions to evaluate
+ * @param  env   the environment to evaluate them in
+ * @return the value of the last expression**/
+lisp_cell_t *lisp_eval_body(lisp_t *l, unsigned depth, lisp_cell_t *code, lisp_cell_t *env);
+
+/**@brief  Run a procedure with the bytecode virtual machine, compiling it
+ *         first if this is the first time it has been run by it.
+ * @param  l    the lisp environment
+ * @param  depth current evaluation depth, not to exceed a limit
+ * @param  proc the procedure to run
+ * @param  env  the environment made by lisp_function_args() for the call
+ * @return the value the procedure returns**/
+lisp_cell_t *lisp_vm_run(lisp_t *l, unsigned depth, lisp_cell_t *proc, lisp_cell_t *env);
+
+/**@brief  Optimize an expression "compile" has resolved, after the
+ *         expressions within it have been optimized, see opt.c
+ * @param  l   the lisp environment
+ * @param  exp the resolved expression
+ * @return the optimized expression, or "exp" if it cannot be optimized**/
+lisp_cell_t *lisp_optimize(lisp_t *l, lisp_cell_t *exp);
 
 /**@brief  Extend the top level lisp environment with a key value pair
  * @param  l   the lisp environment to perform the extension on
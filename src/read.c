@@ -154,12 +154,14 @@ static char *read_string(lisp_t * l, io_t * i) {
 	return NULL;
 }
 
-static int keyval(lisp_t * l, io_t * i, hash_table_t *ht, char *key) {
+static int keyval(lisp_t * l, io_t * i, lisp_cell_t *h, char *key) {
 	lisp_cell_t *val;
 	if (!(val = reader(l, i)))
 		return -1;
-	if (hash_insert(ht, key, cons(l, mk_str(l, key), val)) < 0)
+	lisp_cell_t *k = mk_str(l, key);
+	if (hash_insert(get_hash(h), get_str(k), cons(l, k, val)) < 0)
 		return -1;
+	lisp_gc_write_barrier(h);
 	return 0;
 }
 
@@ -190,7 +192,7 @@ static lisp_cell_t *read_hash(lisp_t * l, io_t * i) {
 			token = NULL;
 			if (!(key = read_string(l, i)))
 				goto fail;
-			if (keyval(l, i, ht, key) < 0)
+			if (keyval(l, i, ret, key) < 0)
 				goto fail;
 			continue;
 		}
@@ -201,7 +203,7 @@ static lisp_cell_t *read_hash(lisp_t * l, io_t * i) {
 				goto fail;
 			}
 
-			if (keyval(l, i, ht, new_token(l)) < 0)
+			if (keyval(l, i, ret, new_token(l)) < 0)
 				goto fail;
 			free(token);
 			continue;
@@ -225,10 +227,11 @@ static lisp_cell_t *new_sym(lisp_t *l, const char *token, size_t end) { /**@bug
 		LISP_RECOVER(l, "%r\"unexpected integer or float\"\n %m%s%t", token);
 	char *tnew = lisp_calloc(l, end+1);
 	memcpy(tnew, token, end);
-	ret = lisp_intern(l, tnew);
-	if (get_sym(ret) != tnew)
+	if ((ret = hash_lookup(get_hash(l->all_symbols), tnew))) {
 		free(tnew);
-	return ret;
+		return ret;
+	}
+	return lisp_intern(l, tnew);
 }
 
 static const char symbol_splitters[] = ".!"; /**@note '~' (negate) and ':' (compose) go here, when implemented*/
@@ -120,6 +120,7 @@ int lisp_repl(lisp_t * l, char *prompt, int editor_on) {
 		l->recover_init = 0;
 		return r;
 	}
+	l->gc_stack_used = 0; /*anything an error left behind can be collected*/
 	l->recover_init = 1;
 	if (editor_on && l->editor) {	/*handle line editing functionality */
 		while ((line = l->editor(prompt))) {
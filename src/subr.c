@@ -40,9 +40,8 @@
 	X("copy",        subr_copy,      "A",    "perform a recursive copy of an expression, if possible")\
 	X("define-eval", subr_define_eval, "s A", "extend the top level environment with a computed symbol")\
 	X("depth",       subr_depth,     "",      "get the current evaluation depth")\
-	X("environment", subr_environment, "",    "get the current environment")\
+	X("environment", subr_environment, "",    "get the current environment as an 'a-list'")\
 	X("is-eof",      subr_eofp,      "P",    "is the EOF flag set on a port?")\
-	X("eq",          subr_eq,        "A A",  "equality operation")\
 	X("eval",        subr_eval,      NULL,   "evaluate an expression")\
 	X("ferror",      subr_ferror,    "P",    "is the error flag set on a port")\
 	X("flush",       subr_flush,     NULL,   "flush a port")\
@@ -52,16 +51,13 @@
 	X("get-delim",   subr_getdelim,  "i C",  "read in a string delimited by a character from a port")\
 	X("get-system-variable", subr_getenv,    "Z",    "get an environment variable from the system (not thread safe)")\
 	X("get-io-str",  subr_get_io_str,"P",    "get a copy of a string from an IO string port")\
-	X("hash-create", subr_hash_create,   NULL,   "create a new hash")\
-	X("hash-info",   subr_hash_info,     "h",    "get information about a hash")\
-	X("hash-insert", subr_hash_insert,   "h Z A", "insert a variable into a hash")\
-	X("hash-lookup", subr_hash_lookup,   "h Z",  "loop up a variable in a hash")\
 	X("is-input",    subr_inp,       "A",    "is an object an input port?")\
 	X("length",      subr_length,    "A",    "return the length of a list or string")\
 	X("match",       subr_match,     "Z Z",  "perform a primitive match on a string")\
 	X("open",        subr_open,      "d Z",  "open a port (either a file or a string) for reading *or* writing")\
 	X("is-output",   subr_outp,      "A",    "is an object an output port?")\
 	X("print",       subr_print,     "o A",  "print out an s-expression")\
+	X("procedure-environment", subr_proc_env, "l", "get the environment a procedure was made in as an 'a-list'")\
 	X("put-char",    subr_putchar,   "o d",  "write a character to a output port")\
 	X("put",         subr_puts,      "o Z",  "write a string to a output port")\
 	X("raw",         subr_raw,       "A",    "get the raw value of an object")\
@@ -76,38 +72,77 @@
 	X("set-car",     subr_setcar,    "c A",  "destructively set the first cell of a cons cell")\
 	X("set-cdr",     subr_setcdr,    "c A",  "destructively set the second cell of a cons cell")\
 	X("signal",      subr_signal,     "d",    "raise a signal")\
-	X("&",           subr_band,      "d d",  "bit-wise and of two integers")\
-	X("~",           subr_binv,      "d",    "bit-wise inversion of an integers")\
-	X("|",           subr_bor,       "d d",  "bit-wise or of two integers")\
-	X("^",           subr_bxor,      "d d",  "bit-wise xor of two integers")\
-	X("<<",          subr_lshift,    "d d",  "logical left shift an integer")\
-	X(">>",          subr_rshift,    "d d",  "logical right shift an integer")\
-	X("/",           subr_div,       "a a",  "divide operation")\
-	X("=",           subr_eq,        "A A",  "equality operation")\
-	X(">",           subr_greater,   NULL,   "greater operation")\
-	X("<",           subr_less,      NULL,   "less than operation")\
-	X("%",           subr_mod,       "d d",  "modulo operation")\
-	X("*",           subr_prod,      "a a",  "multiply two numbers")\
-	X("-",           subr_sub,       "a a",  "subtract two numbers")\
-	X("+",           subr_sum,       "a a",  "add two numbers")\
 	X("substring",   subr_substring, NULL,   "create a substring from a string")\
 	X("tell",        subr_tell,      "P",    "return the position indicator of a port")\
 	X("top-environment", subr_top_env, "",   "return the top level environment")\
 	X("trace",       subr_trace,     "d",    "set the log level, from no errors printed, to copious debugging information")\
 	X("tr",          subr_tr,        "Z Z Z Z", "translate a string given a format and mode")\
-	X("type-of",     subr_typeof,    "A",    "return an integer representing the type of an object")
+	X("type-of",     subr_typeof,    "A",    "return an integer representing the type of an object")\
+	X("weak",        subr_weak,      "A",    "make a weak reference to an object, it does not stop the object being collected")\
+	X("weak-get",    subr_weak_get,  "w",    "get the object a weak reference refers to, or nil if it has been collected")
+
+/* Primitives passed their arguments as an array instead of a list, see
+ * mk_subr_vector(), the format is the same as SUBROUTINE_XLIST */
+#define SUBROUTINE_VECTOR_XLIST\
+	X("eq",          subr_eq,        "A A",  "equality operation")\
+	X("hash-create", subr_hash_create,   NULL,   "create a new hash")\
+	X("hash-info",   subr_hash_info,     "h",    "get information about a hash")\
+	X("hash-insert", subr_hash_insert,   "h Z A", "insert a variable into a hash")\
+	X("hash-lookup", subr_hash_lookup,   "h Z",  "loop up a variable in a hash")\
+	X("hash-weak",   subr_hash_weak,     "h b b", "make the keys and/or values of a hash weak, entries are removed once either is collected")\
+	X("&",           subr_band,      NULL,   "bit-wise and of integers")\
+	X("~",           subr_binv,      "d",    "bit-wise inversion of an integers")\
+	X("|",           subr_bor,       NULL,   "bit-wise or of integers")\
+	X("^",           subr_bxor,      NULL,   "bit-wise xor of integers")\
+	X("<<",          subr_lshift,    "d d",  "logical left shift an integer")\
+	X(">>",          subr_rshift,    "d d",  "logical right shift an integer")\
+	X("/",           subr_div,       NULL,   "divide a number by the rest, or one by a number")\
+	X("=",           subr_equal,     NULL,   "equality operation, numbers are compared by value")\
+	X(">",           subr_greater,   NULL,   "are the arguments in descending order?")\
+	X("<",           subr_less,      NULL,   "are the arguments in ascending order?")\
+	X("%",           subr_mod,       NULL,   "modulo operation, of the first integer by the rest")\
+	X("*",           subr_prod,      NULL,   "multiply numbers")\
+	X("-",           subr_sub,       NULL,   "subtract numbers from the first, or negate a number")\
+	X("+",           subr_sum,       NULL,   "add numbers")
+
+/**@brief built in subroutines without side effects, "compile" calls them
+ *        when their arguments are constant, see opt.c*/
+#define PURE_XLIST\
+	X("car") X("cdr") X("eq") X("=") X("<") X(">") X("+") X("-") X("*")\
+	X("/") X("%") X("&") X("|") X("^") X("~") X("<<") X(">>")\
+	X("length") X("type-of")
+
+/**@brief built in subroutines the evaluator and virtual machine do the
+ *        arithmetic of inline, see lisp_arith()*/
+#define ARITH_XLIST\
+	X("+", ARITH_ADD) X("-", ARITH_SUB) X("*", ARITH_MUL) X("/", ARITH_DIV)\
+	X("%", ARITH_MOD) X("<", ARITH_LESS) X(">", ARITH_GREATER) X("=", ARITH_EQUAL)
 
 #define X(NAME, SUBR, VALIDATION, DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, lisp_cell_t *args);
 SUBROUTINE_XLIST /*function prototypes for all of the built-in subroutines*/
 #undef X
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) static lisp_cell_t * SUBR (lisp_t *l, size_t argc, lisp_cell_t **argv);
+SUBROUTINE_VECTOR_XLIST
+#undef X
 
-#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR },
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), SUBR, NULL },
 static const lisp_module_subroutines_t primitives[] = {
         SUBROUTINE_XLIST /*all of the subr functions*/
-        {NULL, NULL, NULL, NULL} /*must be terminated with NULLs*/
+#undef X
+#define X(NAME, SUBR, VALIDATION, DOCSTRING) { NAME, VALIDATION, MK_DOCSTR(NAME, DOCSTRING), NULL, SUBR },
+        SUBROUTINE_VECTOR_XLIST
+        {NULL, NULL, NULL, NULL, NULL} /*must be terminated with NULLs*/
 };
 #undef X
 
+#define X(NAME) NAME,
+static const char *pure_primitives[] = { PURE_XLIST NULL };
+#undef X
+
+#define X(NAME, OP) { NAME, OP },
+static const struct { const char *name; lisp_arith_op op; } arith_primitives[] = { ARITH_XLIST { NULL, ARITH_NONE } };
+#undef X
+
 /**< X-Macros of all built in integers*/
 #define INTEGER_XLIST\
 	X("*seek-cur*",     SEEK_CUR)     X("*seek-set*",    SEEK_SET)\
@@ -119,6 +154,8 @@ static const lisp_module_subroutines_t primitives[] = {
 	X("*f-procedure*",  FPROC)        X("*file-in*",      IO_FIN)\
 	X("*file-out*",     IO_FOUT)      X("*string-in*",    IO_SIN)\
  	X("*string-out*",   IO_SOUT)      X("*user-defined*", USERDEF)\
+	X("*weak*",         WEAK)         X("*variable*",     VARIABLE)\
+	X("*frame*",        FRAME)\
 	X("*eof*",          EOF)          X("*sig-abrt*",     SIGABRT)\
 	X("*sig-fpe*",      SIGFPE)       X("*sig-ill*",      SIGILL)\
 	X("*sig-int*",      SIGINT)       X("*sig-segv*",     SIGSEGV)\
@@ -133,15 +170,15 @@ static const struct integer_list { char *name; intptr_t val; } integers[] = {
 };
 #undef X
 
-#define X(CNAME, LNAME) static lisp_cell_t _ ## CNAME = { SYMBOL, 0, 1, 0, 0, .p[0].v = LNAME};
+#define X(CNAME, LNAME, FORM) static lisp_cell_t _ ## CNAME = { .type = SYMBOL, .uncollectable = 1, .form = FORM_ ## FORM, .p[0].v = LNAME};
 CELL_XLIST /*structs for special cells*/
 #undef X
 
-#define X(CNAME, NOT_USED) static lisp_cell_t * CNAME = & _ ## CNAME;
+#define X(CNAME, NOT_USED, FORM) static lisp_cell_t * CNAME = & _ ## CNAME;
 CELL_XLIST /*pointers to structs for special cells*/
 #undef X
 
-#define X(CNAME, NOT_USED) { & _ ## CNAME },
+#define X(CNAME, NOT_USED, FORM) { & _ ## CNAME },
 /**@brief a list of all the special symbols**/
 static const struct special_cell_list { lisp_cell_t *internal; } special_cells[] = {
         CELL_XLIST
@@ -149,7 +186,7 @@ static const struct special_cell_list { lisp_cell_t *internal; } special_cells[]
 };
 #undef X
 
-#define X(FNAME, IGNORE) lisp_cell_t *gsym_ ## FNAME (void) { return FNAME ; }
+#define X(FNAME, IGNORE, FORM) lisp_cell_t *gsym_ ## FNAME (void) { return FNAME ; }
 CELL_XLIST /**< defines functions to get a lisp "cell" for the built in special symbols*/
 #undef X
 
@@ -158,6 +195,7 @@ static lisp_cell_t *forced_add_symbol(lisp_t *l, lisp_cell_t *ob) {
         assert(hash_lookup(get_hash(l->all_symbols), get_sym(ob)) == NULL);
         if (hash_insert(get_hash(l->all_symbols), get_sym(ob), ob) < 0)
 		return NULL;
+        lisp_gc_write_barrier(l->all_symbols);
         return l->tee;
 }
 
@@ -173,13 +211,15 @@ lisp_t *lisp_init(void) {
 	lisp_set_log_level(l, LISP_LOG_LEVEL_ERROR);
 
         l->gc_off = 1;
+        lisp_gc_set_policy(l, GC_GROWTH_FACTOR, GC_MIN_HEAP, GC_MAX_HEAP);
+        lisp_gc_set_parallel_heap(l, GC_PARALLEL_HEAP);
         if (!(l->buf = calloc(DEFAULT_LEN, 1))) goto fail;
         l->buf_allocated = DEFAULT_LEN;
         if (!(l->gc_stack = calloc(DEFAULT_LEN, sizeof(*l->gc_stack))))
                 goto fail;
         l->gc_stack_allocated = DEFAULT_LEN;
 
-#define X(CNAME, LNAME) l-> CNAME = CNAME;
+#define X(CNAME, LNAME, FORM) l-> CNAME = CNAME;
 CELL_XLIST
 #undef X
         assert(MAX_RECURSION_DEPTH < INT_MAX);
@@ -228,6 +268,11 @@ CELL_XLIST
                                         mk_int(l, integers[i].val)))
                         goto fail;
 	lisp_add_module_subroutines(l, primitives, 0);
+        l->eq = cdr(hash_lookup(get_hash(l->top_hash), "eq"));
+        for (i = 0; pure_primitives[i]; i++) /*mark the pure subroutines*/
+                cdr(hash_lookup(get_hash(l->top_hash), pure_primitives[i]))->pure = 1;
+        for (i = 0; arith_primitives[i].name; i++) /*mark the ones done inline*/
+                cdr(hash_lookup(get_hash(l->top_hash), arith_primitives[i].name))->arith = arith_primitives[i].op;
         l->gc_off = 0;
         return l;
 fail:   l->gc_off = 0;
@@ -235,122 +280,230 @@ fail:   l->gc_off = 0;
         return NULL;
 }
 
-static lisp_cell_t *subr_band(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, (uintptr_t)get_int(car(args)) & (uintptr_t)get_int(CADR(args)));
+/**@brief check the arguments of a numeric primitive are integers or
+ *        floats, or only integers if "ints" is set, and that there are at
+ *        least "min" of them
+ * @return non zero if any of them is a float*/
+static int arith_args(lisp_t * l, size_t argc, lisp_cell_t ** argv, size_t min, int ints) {
+	int floats = 0;
+	if (argc < min)
+		goto fail;
+	for (size_t i = 0; i < argc; i++) {
+		if (ints ? !is_int(argv[i]) : !is_arith(argv[i]))
+			goto fail;
+		floats |= is_floating(argv[i]);
+	}
+	return floats;
+ fail:	LISP_RECOVER(l, "\"expected (%s...) with at least %d arguments\"\n '%S",
+			ints ? "integer" : "integer-or-float", (intptr_t)min, lisp_args_list(l, argc, argv));
+	return 0;
 }
 
-static lisp_cell_t *subr_bor(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, (uintptr_t)get_int(car(args)) | (uintptr_t)get_int(CADR(args)));
+static lisp_cell_t *subr_band(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	uintptr_t d = UINTPTR_MAX;
+	arith_args(l, argc, argv, 0, 1);
+	for (size_t i = 0; i < argc; i++)
+		d &= (uintptr_t)get_int(argv[i]);
+	return mk_int(l, d);
 }
 
-static lisp_cell_t *subr_bxor(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, (uintptr_t)get_int(car(args)) ^ (uintptr_t)get_int(CADR(args)));
+static lisp_cell_t *subr_bor(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	uintptr_t d = 0;
+	arith_args(l, argc, argv, 0, 1);
+	for (size_t i = 0; i < argc; i++)
+		d |= (uintptr_t)get_int(argv[i]);
+	return mk_int(l, d);
 }
 
-static lisp_cell_t *subr_lshift(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, (uintptr_t)get_int(car(args)) << (uintptr_t)get_int(CADR(args)));
+static lisp_cell_t *subr_bxor(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	uintptr_t d = 0;
+	arith_args(l, argc, argv, 0, 1);
+	for (size_t i = 0; i < argc; i++)
+		d ^= (uintptr_t)get_int(argv[i]);
+	return mk_int(l, d);
 }
 
-static lisp_cell_t *subr_rshift(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, (uintptr_t)get_int(car(args)) >> (uintptr_t)get_int(CADR(args)));
+static lisp_cell_t *subr_lshift(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	UNUSED(argc);
+	return mk_int(l, (uintptr_t)get_int(argv[0]) << (uintptr_t)get_int(argv[1]));
 }
 
-static lisp_cell_t *subr_binv(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, ~get_int(car(args)));
+static lisp_cell_t *subr_rshift(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	UNUSED(argc);
+	return mk_int(l, (uintptr_t)get_int(argv[0]) >> (uintptr_t)get_int(argv[1]));
 }
 
-/** For numerical operations
- * @todo Floating point numbers should infect the operation:
- *       float + integer = float, integer + float = float
- * @todo Add in overloads for user defined types
- * @todo Take an arbitrary number of arguments */
-
-static lisp_cell_t *subr_sum(lisp_t * l, lisp_cell_t * args) {
-	lisp_cell_t *x = car(args), *y = CADR(args);
-	if (is_int(x))
-		return mk_int(l, get_int(x) + get_a2i(y));
-	return mk_float(l, get_float(x) + get_a2f(y));
+static lisp_cell_t *subr_binv(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	UNUSED(argc);
+	return mk_int(l, ~get_int(argv[0]));
 }
 
-static lisp_cell_t *subr_sub(lisp_t * l, lisp_cell_t * args) {
-	lisp_cell_t *x = car(args), *y = CADR(args);
-	if (is_int(x))
-		return mk_int(l, get_int(x) - get_a2i(y));
-	return mk_float(l, get_float(x) - get_a2f(y));
-}
+/** For numerical operations, which take any number of arguments. If any
+ * of them is a float the operation is done on floats, otherwise it is done
+ * on integers.
+ * @todo Add in overloads for user defined types */
 
-static lisp_cell_t *subr_prod(lisp_t * l, lisp_cell_t * args) {
-	lisp_cell_t *x = car(args), *y = CADR(args);
-	if (is_int(x))
-		return mk_int(l, get_int(x) * get_a2i(y));
-	return mk_float(l, get_float(x) * get_a2f(y));
+static lisp_cell_t *subr_sum(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	if (arith_args(l, argc, argv, 0, 0)) {
+		lisp_float_t f = 0.;
+		for (size_t i = 0; i < argc; i++)
+			f += get_a2f(argv[i]);
+		return mk_float(l, f);
+	}
+	intptr_t d = 0;
+	for (size_t i = 0; i < argc; i++)
+		d += get_int(argv[i]);
+	return mk_int(l, d);
+}
+
+static lisp_cell_t *subr_sub(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	if (arith_args(l, argc, argv, 1, 0)) {
+		lisp_float_t f = get_a2f(argv[0]);
+		if (argc == 1)
+			return mk_float(l, -f);
+		for (size_t i = 1; i < argc; i++)
+			f -= get_a2f(argv[i]);
+		return mk_float(l, f);
+	}
+	intptr_t d = get_int(argv[0]);
+	if (argc == 1)
+		return mk_int(l, -d);
+	for (size_t i = 1; i < argc; i++)
+		d -= get_int(argv[i]);
+	return mk_int(l, d);
+}
+
+static lisp_cell_t *subr_prod(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	if (arith_args(l, argc, argv, 0, 0)) {
+		lisp_float_t f = 1.;
+		for (size_t i = 0; i < argc; i++)
+			f *= get_a2f(argv[i]);
+		return mk_float(l, f);
+	}
+	intptr_t d = 1;
+	for (size_t i = 0; i < argc; i++)
+		d *= get_int(argv[i]);
+	return mk_int(l, d);
 }
 
-static lisp_cell_t *subr_mod(lisp_t * l, lisp_cell_t * args) {
+static lisp_cell_t *subr_mod(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
 	intptr_t dividend, divisor;
-	dividend = get_int(car(args));
-	divisor = get_int(CADR(args));
-	if (!divisor || (dividend == INTPTR_MIN && divisor == -1))
-		LISP_RECOVER(l, "\"invalid divisor values\"\n '%S", args);
-	return mk_int(l, dividend % divisor);
-}
-
-static lisp_cell_t *subr_div(lisp_t * l, lisp_cell_t * args) {
-	lisp_float_t dividend, divisor;
-	if (is_int(car(args))) {
-		intptr_t dividend, divisor;
-		dividend = get_int(car(args));
-		divisor = get_a2i(CADR(args));
+	arith_args(l, argc, argv, 2, 1);
+	dividend = get_int(argv[0]);
+	for (size_t i = 1; i < argc; i++) {
+		divisor = get_int(argv[i]);
+		if (!divisor || (dividend == INTPTR_MIN && divisor == -1))
+			LISP_RECOVER(l, "\"invalid divisor values\"\n '%S", lisp_args_list(l, argc, argv));
+		dividend %= divisor;
+	}
+	return mk_int(l, dividend);
+}
+
+/**@brief divide the first argument by the rest, or one by the first if
+ *        there is only one*/
+static lisp_cell_t *subr_div(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	const size_t first = argc == 1 ? 0 : 1;
+	if (arith_args(l, argc, argv, 1, 0)) {
+		lisp_float_t dividend = first ? get_a2f(argv[0]) : 1., divisor;
+		for (size_t i = first; i < argc; i++) {
+			if ((divisor = get_a2f(argv[i])) == 0.)
+				LISP_RECOVER(l, "\"division by zero\"\n '%S", lisp_args_list(l, argc, argv));
+			dividend /= divisor;
+		}
+		return mk_float(l, dividend);
+	}
+	intptr_t dividend = first ? get_int(argv[0]) : 1, divisor;
+	for (size_t i = first; i < argc; i++) {
+		divisor = get_int(argv[i]);
 		if (!divisor || (dividend == INTPTR_MIN && divisor == -1))
-			LISP_RECOVER(l, "\"invalid divisor values\"\n '%S", args);
-		return mk_int(l, dividend / divisor);
+			LISP_RECOVER(l, "\"invalid divisor values\"\n '%S", lisp_args_list(l, argc, argv));
+		dividend /= divisor;
 	}
-	dividend = get_float(car(args));
-	divisor = get_a2f(CADR(args));
-	if (divisor == 0.)
-		LISP_RECOVER(l, "\"division by zero\"\n '%S", args);
-	return mk_float(l, dividend / divisor);
+	return mk_int(l, dividend);
 }
 
-static lisp_cell_t *subr_greater(lisp_t * l, lisp_cell_t * args) {
-	lisp_cell_t *x, *y;
-	if (!lisp_check_length(args, 2))
-		goto fail;
-	x = car(args);
-	y = CADR(args);
-	if (is_arith(x) && is_arith(y)) {
-		return (is_floating(x) ? get_float(x) : get_int(x)) >
-		    (is_floating(y) ? get_float(y) : get_int(y)) ? l->tee : l->nil;
-	} else if (is_asciiz(x) && is_asciiz(y)) {
-		size_t lx = get_length(x), ly = get_length(y);
-		if (lx == ly)
-			return memcmp(get_str(x), get_str(y), lx) > 0 ? l->tee : l->nil;
-		return lx > ly ? l->tee : l->nil;
+lisp_cell_t *lisp_arith(lisp_t * l, lisp_cell_t * f, lisp_cell_t * x, lisp_cell_t * y) {
+	lisp_float_t fx, fy;
+	intptr_t ix, iy;
+	if (is_fixnum(f) || f->arith == ARITH_NONE)
+		return NULL;
+	if (is_fixnum(x) && is_fixnum(y)) { /*no fixnum is INTPTR_MIN*/
+		ix = get_int(x);
+		iy = get_int(y);
+		switch ((lisp_arith_op)f->arith) {
+		case ARITH_ADD:     return mk_int(l, ix + iy);
+		case ARITH_SUB:     return mk_int(l, ix - iy);
+		case ARITH_MUL:     return mk_int(l, ix * iy);
+		case ARITH_DIV:     return iy ? mk_int(l, ix / iy) : NULL;
+		case ARITH_MOD:     return iy ? mk_int(l, ix % iy) : NULL;
+		case ARITH_LESS:    return ix < iy ? l->tee : l->nil;
+		case ARITH_GREATER: return ix > iy ? l->tee : l->nil;
+		case ARITH_EQUAL:   return ix == iy ? l->tee : l->nil;
+		case ARITH_NONE:    break;
+		}
+		return NULL;
 	}
- fail:	LISP_RECOVER(l, "\"expected (number number) or (string string)\"\n '%S", args);
-	return l->error;
+	if (!is_arith(x) || !is_arith(y) || (is_int(x) && is_int(y)))
+		return NULL; /*integers too big to be fixnums are left to "f"*/
+	fx = get_a2f(x); /*integers are promoted, as "f" does*/
+	fy = get_a2f(y);
+	switch ((lisp_arith_op)f->arith) {
+	case ARITH_ADD:     return mk_float(l, fx + fy);
+	case ARITH_SUB:     return mk_float(l, fx - fy);
+	case ARITH_MUL:     return mk_float(l, fx * fy);
+	case ARITH_DIV:     return fy != 0. ? mk_float(l, fx / fy) : NULL;
+	case ARITH_LESS:    return fx < fy ? l->tee : l->nil;
+	case ARITH_GREATER: return fx > fy ? l->tee : l->nil;
+	case ARITH_EQUAL:   return fx == fy ? l->tee : l->nil;
+	case ARITH_MOD:
+	case ARITH_NONE:    break;
+	}
+	return NULL;
 }
 
-static lisp_cell_t *subr_less(lisp_t * l, lisp_cell_t * args) {
-	lisp_cell_t *x, *y;
-	if (!lisp_check_length(args, 2))
+/**@brief check each argument is ordered against the next as "order"
+ *        says, -1 for ascending and 1 for descending, for "<" and ">".
+ *        Numbers are compared with numbers and strings with strings.*/
+static lisp_cell_t *compare(lisp_t * l, size_t argc, lisp_cell_t ** argv, int order) {
+	lisp_cell_t *ret = l->tee;
+	if (!argc)
 		goto fail;
-	x = car(args);
-	y = CADR(args);
-	if (is_arith(x) && is_arith(y)) {
-		return (is_floating(x) ? get_float(x) : get_int(x)) <
-		    (is_floating(y) ? get_float(y) : get_int(y)) ? l->tee : l->nil;
-	} else if (is_asciiz(x) && is_asciiz(y)) {
-		size_t lx = get_length(x), ly = get_length(y);
-		if (lx == ly)
-			return memcmp(get_str(x), get_str(y), lx) < 0 ? l->tee : l->nil;
-		return lx < ly ? l->tee : l->nil;
+	for (size_t i = 0; i + 1 < argc; i++) {
+		lisp_cell_t *x = argv[i], *y = argv[i + 1];
+		int c;
+		if (is_int(x) && is_int(y)) {
+			c = (get_int(x) > get_int(y)) - (get_int(x) < get_int(y));
+		} else if (is_arith(x) && is_arith(y)) {
+			lisp_float_t fx = get_a2f(x), fy = get_a2f(y);
+			c = (fx > fy) - (fx < fy);
+		} else if (is_asciiz(x) && is_asciiz(y)) {
+			size_t lx = get_length(x), ly = get_length(y);
+			if (lx == ly) {
+				int r = memcmp(get_str(x), get_str(y), lx);
+				c = (r > 0) - (r < 0);
+			} else {
+				c = lx > ly ? 1 : -1;
+			}
+		} else {
+			goto fail;
+		}
+		if (c != order)
+			ret = l->nil;
 	}
- fail:	LISP_RECOVER(l, "\"expected (number number) or (string string)\"\n '%S", args);
+	return ret;
+ fail:	LISP_RECOVER(l, "\"expected (number...) or (string...)\"\n '%S", lisp_args_list(l, argc, argv));
 	return l->error;
 }
 
-static lisp_cell_t *subr_eq(lisp_t * l, lisp_cell_t * args) {
+static lisp_cell_t *subr_greater(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	return compare(l, argc, argv, 1);
+}
+
+static lisp_cell_t *subr_less(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	return compare(l, argc, argv, -1);
+}
+
+static lisp_cell_t *subr_eq(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
 	/**@warning Most versions of equality treat the floating
 	 * point value NaN specially, NaN does not equal NaN,
 	 * disregarding the reflexive property that is usually
@@ -360,8 +513,9 @@ static lisp_cell_t *subr_eq(lisp_t * l, lisp_cell_t * args) {
 	 * size of a lisp float could be greater than or less
 	 * than a pointer. What should be done needs to be decided. */
 	lisp_cell_t *x, *y;
-	x = car(args);
-	y = CADR(args);
+	UNUSED(argc);
+	x = argv[0];
+	y = argv[1];
 	if (get_int(x) == get_int(y))
 		return l->tee;
 	if (is_floating(x) && is_floating(y))
@@ -378,6 +532,27 @@ static lisp_cell_t *subr_eq(lisp_t * l, lisp_cell_t * args) {
 	return l->nil;
 }
 
+/**@brief "=" is "eq" on each argument and the next, apart from integers
+ *        and floats, which are compared by their value*/
+static lisp_cell_t *subr_equal(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	lisp_cell_t *ret = l->tee;
+	if (!argc)
+		LISP_RECOVER(l, "\"%s\"", "expected at least one argument");
+	for (size_t i = 0; i + 1 < argc; i++) {
+		lisp_cell_t *x = argv[i], *y = argv[i + 1];
+		if (is_int(x) && is_int(y)) {
+			if (get_int(x) != get_int(y))
+				ret = l->nil;
+		} else if (is_arith(x) && is_arith(y)) {
+			if (get_a2f(x) != get_a2f(y))
+				ret = l->nil;
+		} else if (subr_eq(l, 2, argv + i) == l->nil) {
+			ret = l->nil;
+		}
+	}
+	return ret;
+}
+
 static lisp_cell_t *subr_cons(lisp_t * l, lisp_cell_t * args) {
 	return cons(l, car(args), CADR(args));
 }
@@ -452,7 +627,7 @@ static lisp_cell_t *subr_eval(lisp_t * l, lisp_cell_t * args) {
 	if (lisp_check_length(args, 1))
 		x = eval(l, l->cur_depth, car(args), l->top_env);
 	if (lisp_check_length(args, 2)) {
-		if (!is_cons(CADR(args)))
+		if (!is_cons(CADR(args)) && !is_frame(CADR(args)))
 			LISP_RECOVER(l, "\"expected a-list\"\n '%S", args);
 		x = eval(l, l->cur_depth, car(args), CADR(args));
 	}
@@ -614,25 +789,31 @@ static lisp_cell_t *subr_rename(lisp_t * l, lisp_cell_t * args) {
 	return rename(get_str(car(args)), get_str(CADR(args))) ? l->nil : l->tee;
 }
 
-static lisp_cell_t *subr_hash_lookup(lisp_t * l, lisp_cell_t * args) { /*arbitrary expressions could be used as keys if they are serialized to strings first*/
+static lisp_cell_t *subr_hash_lookup(lisp_t * l, size_t argc, lisp_cell_t ** argv) { /*arbitrary expressions could be used as keys if they are serialized to strings first*/
 	lisp_cell_t *x;
-	return (x = hash_lookup(get_hash(car(args)), get_sym(CADR(args)))) ? x : l->nil;
+	UNUSED(argc);
+	return (x = hash_lookup(get_hash(argv[0]), get_sym(argv[1]))) ? x : l->nil;
 }
 
-static lisp_cell_t *subr_hash_insert(lisp_t * l, lisp_cell_t * args) {
-	if (hash_insert(get_hash(car(args)),
-			get_sym(CADR(args)), cons(l, CADR(args), CADR(cdr(args)))))
+static lisp_cell_t *subr_hash_insert(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	UNUSED(argc);
+	if (hash_insert(get_hash(argv[0]),
+			get_sym(argv[1]), cons(l, argv[1], argv[2])))
 		lisp_out_of_memory(l);
-	return car(args);
+	lisp_gc_write_barrier(argv[0]);
+	return argv[0];
 }
 
-static lisp_cell_t *subr_hash_create(lisp_t * l, lisp_cell_t * args) {
+/**@brief make a hash from a list of alternating keys and values, as
+ *        "hash-create" does from its arguments, for "coerce"*/
+static lisp_cell_t *hash_from_list(lisp_t * l, lisp_cell_t * args) {
 	hash_table_t *ht = NULL;
+	lisp_cell_t *head = args;
 	if (get_length(args) % 2)
 		goto fail;
 	if (!(ht = hash_create(SMALL_DEFAULT_LEN)))
 		lisp_out_of_memory(l);
-	for (; !is_nil(args); args = cdr(cdr(args))) {
+	for (; is_cons(args) && is_cons(cdr(args)); args = cdr(cdr(args))) {
 		if (!is_asciiz(car(args)))
 			goto fail;
 		if (hash_insert(ht, get_sym(car(args)), cons(l, car(args), CADR(args))) < 0)
@@ -641,12 +822,38 @@ static lisp_cell_t *subr_hash_create(lisp_t * l, lisp_cell_t * args) {
 	return mk_hash(l, ht);
  fail:	hash_destroy(ht);
 	ht = NULL;
-	LISP_RECOVER(l, "\"expected ({symbol any}*)\"\n '%S", args);
+	LISP_RECOVER(l, "\"expected ({symbol any}*)\"\n '%S", head);
 	return l->error;
 }
 
-static lisp_cell_t *subr_hash_info(lisp_t * l, lisp_cell_t * args) {
-	hash_table_t *ht = get_hash(car(args));
+static lisp_cell_t *subr_hash_create(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	hash_table_t *ht = NULL;
+	if (argc % 2)
+		goto fail;
+	if (!(ht = hash_create(SMALL_DEFAULT_LEN)))
+		lisp_out_of_memory(l);
+	for (size_t i = 0; i < argc; i += 2) {
+		if (!is_asciiz(argv[i]))
+			goto fail;
+		if (hash_insert(ht, get_sym(argv[i]), cons(l, argv[i], argv[i + 1])) < 0)
+			lisp_out_of_memory(l);
+	}
+	return mk_hash(l, ht);
+ fail:	hash_destroy(ht);
+	ht = NULL;
+	LISP_RECOVER(l, "\"expected ({symbol any}*)\"\n '%S", lisp_args_list(l, argc, argv));
+	return l->error;
+}
+
+static lisp_cell_t *subr_hash_weak(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	UNUSED(argc);
+	lisp_gc_weak_hash(l, argv[0], !is_nil(argv[1]), !is_nil(argv[2]));
+	return argv[0];
+}
+
+static lisp_cell_t *subr_hash_info(lisp_t * l, size_t argc, lisp_cell_t ** argv) {
+	hash_table_t *ht = get_hash(argv[0]);
+	UNUSED(argc);
 	return mk_list(l,
 		       mk_float(l, hash_get_load_factor(ht)),
 		       mk_int(l,   hash_get_replacements(ht)),
@@ -667,7 +874,7 @@ lisp_cell_t *lisp_coerce(lisp_t * l, lisp_type type, lisp_cell_t *from) {
 	intptr_t d = 0;
 	size_t i = 0, j;
 	lisp_cell_t *x, *y, *head;
-	if (type == from->type)
+	if (type == cell_type(from))
 		return from;
 	switch (type) {
 	case INTEGER:
@@ -749,7 +956,7 @@ lisp_cell_t *lisp_coerce(lisp_t * l, lisp_type type, lisp_cell_t *from) {
 		break;
 	case HASH:
 		if (is_cons(from))	/*hash from list */
-			return subr_hash_create(l, from);
+			return hash_from_list(l, from);
 		break;
 	case FLOAT:
 		if (is_int(from))	/*int to float */
@@ -772,12 +979,20 @@ lisp_cell_t *lisp_coerce(lisp_t * l, lisp_type type, lisp_cell_t *from) {
 }
 
 static lisp_cell_t *subr_assoc(lisp_t * l, lisp_cell_t * args) {
-	UNUSED(l);
-	return lisp_assoc(car(args), CADR(args));
+	return lisp_assoc(l, car(args), CADR(args));
 }
 
 static lisp_cell_t *subr_typeof(lisp_t * l, lisp_cell_t * args) {
-	return mk_int(l, car(args)->type);
+	return mk_int(l, cell_type(car(args)));
+}
+
+static lisp_cell_t *subr_weak(lisp_t * l, lisp_cell_t * args) {
+	return mk_weak(l, car(args));
+}
+
+static lisp_cell_t *subr_weak_get(lisp_t * l, lisp_cell_t * args) {
+	UNUSED(l);
+	return get_weak(car(args));
 }
 
 static lisp_cell_t *subr_close(lisp_t * l, lisp_cell_t * args) {
@@ -793,7 +1008,7 @@ static lisp_cell_t *subr_reverse(lisp_t * l, lisp_cell_t * args) {
 		goto fail;
 	if (l->nil == car(args))
 		return l->nil;
-	switch (car(args)->type) {
+	switch (cell_type(car(args))) {
 	case STRING:
 		{
 			char *s = lisp_strdup(l, get_str(car(args)));
@@ -1090,9 +1305,33 @@ static lisp_cell_t *subr_raw(lisp_t * l, lisp_cell_t * args) {
 	return mk_int(l, (intptr_t) get_raw(car(args)));
 }
 
+/**@brief turn the FRAMEs in an environment into bindings in a list, the
+ *	  bindings in the list that are not in a FRAME are shared with it*/
+static lisp_cell_t *env_to_alist(lisp_t * l, lisp_cell_t * env) {
+	lisp_cell_t *head = cons(l, l->nil, l->nil), *op = head, *rest = env, *e;
+	for (e = env; is_cons(e) || is_frame(e); e = env_next(e))
+		if (is_frame(e))
+			rest = frame_parent(e);
+	for (e = env; e != rest; e = env_next(e)) {
+		if (is_cons(e)) {
+			set_cdr(op, cons(l, car(e), l->nil));
+			op = cdr(op);
+			continue;
+		}
+		for (size_t i = frame_count(e); i--; op = cdr(op))
+			set_cdr(op, cons(l, cons(l, lisp_frame_symbol(e, i), binding_value(e, FRAME_VALUES + i)), l->nil));
+	}
+	set_cdr(op, rest);
+	return cdr(head);
+}
+
 static lisp_cell_t *subr_environment(lisp_t * l, lisp_cell_t * args) {
 	UNUSED(args);
-	return l->cur_env;
+	return env_to_alist(l, l->cur_env);
+}
+
+static lisp_cell_t *subr_proc_env(lisp_t * l, lisp_cell_t * args) {
+	return env_to_alist(l, get_proc_env(car(args)));
 }
 
 static lisp_cell_t *subr_all_syms(lisp_t * l, lisp_cell_t * args) {
@@ -168,6 +168,19 @@ static int sstrcmp(const char *s1, const char *s2)
 	return strcmp(s1, s2);
 }
 
+static void *is_heliotropes(const char *key, void *val)
+{
+	return !strcmp(key, "heliotropes") ? val : NULL;
+}
+
+static size_t live_objects(lisp_gc_stats_t *s)
+{
+	size_t i, live = 0;
+	for (i = 0; i < LISP_GC_STATS_TYPES; i++)
+		live += s->live[i];
+	return live;
+}
+
 int main(int argc, char **argv)
 {
 	if (argc > 1)
@@ -355,6 +368,9 @@ int main(int argc, char **argv)
 		test(!sstrcmp("", hash_lookup(h, "nil")));
 		test(!sstrcmp("z", hash_lookup(h, "a")));
 		test(hash_get_load_factor(h) <= 0.75f);
+		test(hash_remove_if(h, is_heliotropes) == 1);
+		test(!hash_lookup(h, "heliotropes"));
+		test(!sstrcmp("val4", hash_lookup(h, "neurospora")));
 
 		state(hash_destroy(h));
 	}
@@ -373,8 +389,20 @@ int main(int argc, char **argv)
 		test(is_int(lisp_eval_string(l, "2")));
 		test(get_int(lisp_eval_string(l, "(+ 2 2)")) == 4);
 		test(get_int(lisp_eval_string(l, "(* 3 2)")) == 6);
-
-		lisp_cell_t *x = NULL, *y = NULL, *z = NULL;
+		test(get_int(lisp_eval_string(l, "(+ 1 2 3 4)")) == 10);
+		test(get_int(lisp_eval_string(l, "(- 5)")) == -5);
+		test(get_float(lisp_eval_string(l, "(+ 1 0.5)")) == 1.5);
+		test(gsym_tee() == lisp_eval_string(l, "(< 1 2 3)"));
+		test(gsym_nil() == lisp_eval_string(l, "(< 1 3 2)"));
+		test(gsym_tee() == lisp_eval_string(l, "(= 2 2.0)"));
+		test(get_int(lisp_eval_string(l, "(| 1 2 4)")) == 7);
+		test(get_int(mk_int(l, -1)) == -1);
+		test(is_int(mk_int(l, INTPTR_MAX)) && get_int(mk_int(l, INTPTR_MAX)) == INTPTR_MAX);
+		test(is_int(mk_int(l, INTPTR_MIN)) && get_int(mk_int(l, INTPTR_MIN)) == INTPTR_MIN);
+
+		lisp_cell_t *x = NULL, *y = NULL, *volatile z = NULL;
+		lisp_gc_stats_t gs;
+		volatile size_t allocations = 0;
 		char *t = NULL;
 		state(x = lisp_intern(l, lstrdup_or_abort("foo")));
 		state(y = lisp_intern(l, t = lstrdup_or_abort("foo")));	/*this one needs freeing! */
@@ -382,9 +410,77 @@ int main(int argc, char **argv)
 		test(x == y && x != NULL);
 		test(x != z);
 		free(t);	/*free the non-interned string */
+		test(!strcmp(get_sym(x), "foo") && get_length(x) == 3);
+		test(!strcmp(get_str(mk_str(l, lstrdup_or_abort("a string longer than a cell"))), "a string longer than a cell"));
 
 		test(is_proc(lisp_eval_string(l, "(define square (lambda (x) (* x x)))")));
 		test(get_int(lisp_eval_string(l, "(square 4)")) == 16);
+		test(is_proc(lisp_eval_string(l, "(define sum-sq (compile \"\" (x y) (let (a (square x)) (b (square y)) (+ a b))))")));
+		test(get_int(lisp_eval_string(l, "(sum-sq 3 4)")) == 25);
+		test(is_proc(lisp_eval_string(l, "(define square (lambda (x) (* x (* x x))))")));
+		test(get_int(lisp_eval_string(l, "(sum-sq 1 2)")) == 9);
+		test(is_proc(lisp_eval_string(l, "(define square (lambda (x) (* x x)))")));
+
+		test(is_proc(z = lisp_eval_string(l, "(define tri (compile \"\" (n) (let (s 0) (progn (while (> n 0) (setq s (+ s n)) (setq n (- n 1))) s))))")));
+		test(get_int(lisp_eval_string(l, "(tri 100)")) == 5050);
+		state(lisp_set_bytecode(z, 0));
+		test(get_int(lisp_eval_string(l, "(tri 100)")) == 5050);
+		test(is_proc(lisp_eval_string(l, "(define add (compile \"\" (a b) (+ a b)))")));
+		test(get_int(lisp_eval_string(l, "(add 2 3)")) == 5);
+		test(get_float(lisp_eval_string(l, "(add 0.5 0.25)")) == 0.75);
+		test(is_subr(lisp_eval_string(l, "(define plus +)")));
+		test(is_subr(lisp_eval_string(l, "(define + -)")));
+		test(get_int(lisp_eval_string(l, "(add 2 3)")) == -1);
+		test(is_subr(lisp_eval_string(l, "(define + plus)")));
+		test(is_proc(lisp_eval_string(l, "(define count (compile \"\" (n acc) (if (= n 0) acc (count (- n 1) (+ acc 1)))))")));
+		test(get_int(lisp_eval_string(l, "(count 20000 0)")) == 20000);
+		test(is_proc(lisp_eval_string(l, "(define wide (compile \"\" (a b c d e f g h i j k l m n o p) (progn (setq o 0) (+ a (+ o p)))))")));
+		test(get_int(lisp_eval_string(l, "(wide 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16)")) == 17);
+		test(get_int(CADR(lisp_eval_string(l, "((lambda (x . rest) rest) 1 2 3)"))) == 3);
+		test(get_int(cdr(car(lisp_eval_string(l, "((lambda (x y) (environment)) 1 2)")))) == 2);
+		test(is_proc(lisp_eval_string(l, "(define second (lambda (x y) x y))")));
+		test(is_cons(z = lisp_eval_string(l, "'(second 1 2)")));
+		state(lisp_gc_stats(l, &gs));
+		state(allocations = gs.allocations);
+		test(get_int(lisp_eval(l, z)) == 2);
+		state(lisp_gc_stats(l, &gs));
+		test(gs.allocations == allocations + 1); /*only its FRAME*/
+		test(is_cons(z = lisp_eval_string(l, "'(= 1 1)")));
+		state(lisp_gc_stats(l, &gs));
+		state(allocations = gs.allocations);
+		test(lisp_eval(l, z) == gsym_tee());
+		state(lisp_gc_stats(l, &gs));
+		test(gs.allocations == allocations); /*its arguments are passed as an array*/
+
+		test(is_proc(z = lisp_eval_string(l, "(compile \"\" () (* 60 (* 60 24)))")));
+		test(get_int(car(get_proc_code(z))) == 86400);
+		test(is_proc(z = lisp_eval_string(l, "(compile \"\" (x) (if (< 1 2) (tri x) (/ 1 0)))")));
+		test(get_length(car(get_proc_code(z))) == 2);
+		test(is_proc(lisp_eval_string(l, "(define inc (compile \"\" (x) (+ x 1)))")));
+		test(is_proc(lisp_eval_string(l, "(define use (compile \"\" (y) (inc y)))")));
+		test(get_int(lisp_eval_string(l, "(use 1)")) == 2);
+		test(is_proc(lisp_eval_string(l, "(define inc (compile \"\" (x) (+ x 100)))")));
+		test(get_int(lisp_eval_string(l, "(use 1)")) == 101); /*the inlined code is not used*/
+		state(lisp_set_optimize(l, 0));
+		test(is_proc(z = lisp_eval_string(l, "(compile \"\" () (* 60 (* 60 24)))")));
+		test(is_cons(car(get_proc_code(z))));
+		state(lisp_set_optimize(l, 1));
+
+		state(lisp_gc_set_quota(l, 1 << 18));
+		test(is_proc(lisp_eval_string(l, "(define grow (lambda (n acc) (if (= n 0) acc (grow (- n 1) (cons n acc)))))")));
+		test(lisp_eval_string(l, "(grow 20000 nil)") == gsym_error());
+		test(get_int(lisp_eval_string(l, "(square 5)")) == 25);
+		state(lisp_gc_set_quota(l, 0));
+
+		int ud = 0;
+		state(ud = new_user_defined_type(l, NULL, NULL, NULL, NULL));
+		state(z = mk_user(l, &gs, ud));
+		state(lisp_gc_account_external(l, z, 1 << 20));
+		state(lisp_gc_stats(l, &gs));
+		test(gs.external == 1 << 20);
+		state(lisp_gc_account_external(l, z, 0));
+		state(lisp_gc_stats(l, &gs));
+		test(gs.external == 0);
 
 		test(!is_list(cons(l, gsym_tee(), gsym_tee())));
 		test(is_list(cons(l, gsym_tee(), gsym_nil())));
@@ -392,16 +488,196 @@ int main(int argc, char **argv)
 		test(is_list(mk_list(l, gsym_tee(), gsym_nil(), gsym_tee(), NULL)));
 
 		test(gsym_error() == lisp_eval_string(l, "(> 'a 1)"));
+		test(gsym_error() == lisp_eval_string(l, "(hash-lookup 1 \"a\")"));
+		test(gsym_error() == lisp_eval_string(l, "(car '(1) '(2))"));
 		test(is_sym(x));
 		test(is_asciiz(x));
 		test(!is_str(x));
 		test(gsym_error() == lisp_eval_string(l, "(eval (cons quote 0))"));
 
+		test(is_weak(lisp_eval_string(l, "(define weak-keep (weak square))")));
+		test(is_weak(lisp_eval_string(l, "(define weak-drop (weak (cons 1 2)))")));
+		test(is_str(lisp_eval_string(l, "(define weak-key \"kept\")")));
+		test(is_hash(lisp_eval_string(l, "(define weak-values (hash-create \"kept\" square \"dropped\" (cons 1 2)))")));
+		test(is_hash(lisp_eval_string(l, "(define weak-keys (hash-create weak-key 1 \"dropped\" 2))")));
+		test(lisp_eval_string(l, "(progn (hash-weak weak-values nil t) (hash-weak weak-keys t nil) t)") == gsym_tee());
+		state(lisp_gc_mark_and_sweep(l));
+		test(is_proc(lisp_eval_string(l, "(weak-get weak-keep)")));
+		test(is_nil(lisp_eval_string(l, "(weak-get weak-drop)")));
+		test(is_cons(lisp_eval_string(l, "(hash-lookup weak-values \"kept\")")));
+		test(is_nil(lisp_eval_string(l, "(hash-lookup weak-values \"dropped\")")));
+		test(!hash_lookup(get_hash(lisp_eval_string(l, "weak-values")), "dropped"));
+		test(is_cons(lisp_eval_string(l, "(hash-lookup weak-keys \"kept\")")));
+		test(!hash_lookup(get_hash(lisp_eval_string(l, "weak-keys")), "dropped"));
+
 		char *serial = NULL;
 		test(!strcmp((serial = lisp_serialize(l, cons(l, gsym_tee(), gsym_error()))), "(t . error)"));
 		state(free(serial));
 
 		state(lisp_destroy(l));
 	}
+
+	{			/* gc.c */
+		lisp_t *l;
+		lisp_gc_stats_t gs;
+		volatile size_t pages = 0, heap = 0, grown = 0, collections = 0, live = 0;
+
+		print_note("gc.c");
+		state(l = lisp_init());
+		state(io_close(lisp_get_logging(l)));
+		test(!lisp_set_logging(l, io_nout()));
+		return_if(!l);
+		test(is_proc(lisp_eval_string(l, "(define grow (compile \"\" (n) (let (acc nil) (progn (while (> n 0) (setq acc (cons n acc)) (setq n (- n 1))) acc))))")));
+
+		test(get_float(lisp_eval_string(l, "(define half 0.5)")) == 0.5);
+		test(is_str(lisp_eval_string(l, "(define text \"a string that is not in a cons sized cell\")")));
+		state(lisp_gc_mark_and_sweep(l));
+		state(lisp_gc_stats(l, &gs));
+		state(heap = gs.heap);
+		state(pages = gs.pages);
+		test(heap && heap <= pages);
+		test(get_int(lisp_eval_string(l, "(length (define big (grow 20000)))")) == 20000);
+		state(lisp_gc_stats(l, &gs));
+		test(gs.heap > heap);
+		test(gs.pages > pages && gs.heap <= gs.pages);
+		test(is_nil(lisp_eval_string(l, "(define big nil)")));
+		state(lisp_gc_mark_and_sweep(l));
+		state(lisp_gc_stats(l, &gs));
+		test(gs.heap < heap + (heap >> 2));
+		state(pages = gs.pages);
+		test(get_int(lisp_eval_string(l, "(length (define big (grow 20000)))")) == 20000);
+		state(lisp_gc_stats(l, &gs));
+		test(gs.pages == pages); /*the cells that were freed are reused*/
+		state(lisp_gc_mark_and_sweep(l));
+		test(get_int(lisp_eval_string(l, "(foldl + big)")) == 200010000);
+		test(get_float(lisp_eval_string(l, "half")) == 0.5);
+		test(!strcmp(get_str(lisp_eval_string(l, "text")), "a string that is not in a cons sized cell"));
+
+		state(lisp_gc_mark_and_sweep(l));
+		state(lisp_gc_stats(l, &gs));
+		state(heap = gs.heap);
+		test(is_proc(lisp_eval_string(l, "(define split (compile \"\" (n) (let (keep nil) (drop nil) (progn (while (> n 0) (setq keep (cons n keep)) (setq drop (cons n drop)) (setq n (- n 1))) keep))))")));
+		test(get_int(lisp_eval_string(l, "(length (define kept (split 10000)))")) == 10000);
+		state(lisp_gc_stats(l, &gs));
+		state(grown = gs.heap - heap);
+		state(lisp_gc_mark_and_sweep(l));
+		state(lisp_gc_stats(l, &gs));
+		test((gs.heap - heap) * 2 < grown + grown / 8); /*neighbours of kept cells are freed*/
+		test(get_int(lisp_eval_string(l, "(length (grow 20000))")) == 20000);
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		test(is_cons(lisp_eval_string(l, "(set-cdr (define cycle (cons 1 nil)) cycle)")));
+		state(lisp_gc_mark_and_sweep(l));
+		test(get_int(lisp_eval_string(l, "(car (cdr (cdr cycle)))")) == 1);
+
+		test(is_cons(lisp_eval_string(l, "(define old (cons nil nil))")));
+		state(lisp_gc_minor(l));
+		test(lisp_eval_string(l, "(progn (set-car old (grow 1000)) (set-cdr old (grow 1000)) t)") == gsym_tee());
+		test(get_int(lisp_eval_string(l, "(length (grow 20000))")) == 20000);
+		state(lisp_gc_stats(l, &gs));
+		state(heap = gs.heap);
+		state(lisp_gc_minor(l)); /*the new lists are only reachable from an old cell*/
+		state(lisp_gc_stats(l, &gs));
+		test(gs.heap < heap);
+		test(get_int(lisp_eval_string(l, "(length (grow 20000))")) == 20000);
+		test(get_int(lisp_eval_string(l, "(foldl + (car old))")) == 500500);
+		test(get_int(lisp_eval_string(l, "(foldl + (cdr old))")) == 500500);
+
+		state(lisp_gc_set_policy(l, 2.0, 1 << 18, 0));
+		state(lisp_gc_set_budget(l, 4096, 0));
+		state(lisp_gc_stats(l, &gs));
+		state(collections = gs.collections);
+		test(is_proc(lisp_eval_string(l, "(define churn (compile \"\" (box n) (progn (while (> n 0) (set-car box (grow 100)) (setq n (- n 1))) (length (car box)))))")));
+		test(get_int(lisp_eval_string(l, "(churn old 10000)")) == 100); /*written to while it is being marked*/
+		state(lisp_gc_stats(l, &gs));
+		test(gs.collections > collections + 1);
+		test(get_int(lisp_eval_string(l, "(foldl + (car old))")) == 5050);
+		test(get_int(lisp_eval_string(l, "(foldl + (cdr old))")) == 500500);
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		state(lisp_gc_set_budget(l, 0, 0));
+		state(lisp_gc_mark_and_sweep(l));
+		test(get_int(lisp_eval_string(l, "(foldl + (car old))")) == 5050);
+		state(lisp_gc_set_policy(l, 2.0, 1 << 24, 0));
+
+		state(lisp_gc_set_mark_stack(l, 4));
+		test(is_proc(lisp_eval_string(l, "(define pairs (compile \"\" (n) (let (acc nil) (progn (while (> n 0) (setq acc (cons (cons n (cons n nil)) acc)) (setq n (- n 1))) acc))))")));
+		test(is_proc(lisp_eval_string(l, "(define sum-pairs (compile \"\" (x) (let (s 0) (progn (while x (setq s (+ s (+ (car (car x)) (car (cdr (car x)))))) (setq x (cdr x))) s))))")));
+		test(get_int(lisp_eval_string(l, "(length (define wide (pairs 5000)))")) == 5000);
+		state(lisp_gc_stats(l, &gs));
+		state(heap = gs.heap);
+		state(lisp_gc_mark_and_sweep(l)); /*the mark stack overflows and the heap is rescanned*/
+		state(lisp_gc_stats(l, &gs));
+		test(gs.heap < heap);
+		test(get_int(lisp_eval_string(l, "(length (grow 20000))")) == 20000);
+		test(get_int(lisp_eval_string(l, "(sum-pairs wide)")) == 25005000);
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		state(lisp_gc_set_mark_stack(l, 0));
+
+		state(lisp_gc_set_policy(l, 2.0, 1 << 16, 0));
+		test(get_int(lisp_eval_string(l, "(length (define big (grow 200000)))")) == 200000);
+		state(lisp_gc_mark_and_sweep(l));
+		test(lisp_gc_survival_rate(l) > 0.5);
+		state(lisp_gc_stats(l, &gs));
+		state(collections = gs.collections);
+		test(get_int(lisp_eval_string(l, "(length (grow 10000))")) == 10000);
+		state(lisp_gc_stats(l, &gs));
+		test(gs.collections == collections); /*there is room for twice what survived*/
+		test(is_nil(lisp_eval_string(l, "(define big nil)")));
+		state(lisp_gc_mark_and_sweep(l));
+		test(lisp_gc_survival_rate(l) < 0.5);
+		state(lisp_gc_stats(l, &gs));
+		state(collections = gs.collections);
+		test(get_int(lisp_eval_string(l, "(length (grow 50000))")) == 50000);
+		state(lisp_gc_stats(l, &gs));
+		test(gs.collections > collections); /*the threshold came down with the heap*/
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		state(lisp_gc_set_policy(l, 2.0, 1 << 24, 0));
+
+		state(lisp_gc_set_parallel_heap(l, 0));
+		test(!lisp_gc_set_threads(l, 4));
+		test(is_proc(lisp_eval_string(l, "(define fill (compile \"\" (h n) (progn (while (> n 0) (hash-insert h (coerce *string* n) (cons n nil)) (setq n (- n 1))) h)))")));
+		test(is_hash(lisp_eval_string(l, "(fill (define table (hash-create)) 2000)")));
+		test(get_int(lisp_eval_string(l, "(length (define big (pairs 20000)))")) == 20000);
+		test(get_int(lisp_eval_string(l, "(length (grow 50000))")) == 50000);
+		state(lisp_gc_stats(l, &gs));
+		state(heap = gs.heap);
+		state(lisp_gc_mark_and_sweep(l)); /*marked by four threads, swept in the background*/
+		state(lisp_gc_stats(l, &gs));
+		test(gs.heap < heap);
+		test(get_int(lisp_eval_string(l, "(length (grow 50000))")) == 50000);
+		state(lisp_gc_minor(l));
+		test(get_int(lisp_eval_string(l, "(length (grow 50000))")) == 50000);
+		test(get_int(lisp_eval_string(l, "(sum-pairs big)")) == 400020000);
+		test(get_int(lisp_eval_string(l, "(car (cdr (hash-lookup table \"1234\")))")) == 1234);
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		state(lisp_gc_set_threads(l, 1));
+		state(lisp_gc_set_parallel_heap(l, 1 << 26));
+
+		test(get_int(lisp_eval_string(l, "(length (define big (grow 20000)))")) == 20000);
+		state(lisp_gc_stats(l, &gs));
+		state(live = live_objects(&gs));
+		test(is_nil(lisp_eval_string(l, "(define big nil)")));
+		state(lisp_gc_mark_and_sweep(l)); /*leaves the dead cells to be swept later*/
+		state(lisp_gc_stats(l, &gs));
+		test(live_objects(&gs) + 20000 <= live);
+
+		state(lisp_gc_set_policy(l, 2.0, 1 << 16, 0));
+		test(is_proc(lisp_eval_string(l, "(define sparse (compile \"\" (n) (let (all nil) (some nil) (progn (while (> n 0) (setq all (cons n all)) (if (= (% n 20000) 0) (setq some (cons n some)) nil) (setq n (- n 1))) some))))")));
+		test(get_int(lisp_eval_string(l, "(length (define scattered (sparse 200000)))")) == 10);
+		state(lisp_gc_mark_and_sweep(l));
+		state(lisp_gc_stats(l, &gs));
+		state(pages = gs.pages);
+		state(lisp_gc_set_compact(l, 1));
+		state(lisp_gc_mark_and_sweep(l)); /*the pages only the dropped list used are released*/
+		state(lisp_gc_stats(l, &gs));
+		test(gs.pages < pages);
+		test(get_int(lisp_eval_string(l, "(foldl + scattered)")) == 1100000);
+		test(get_int(lisp_eval_string(l, "(length (grow 50000))")) == 50000);
+		test(get_int(lisp_eval_string(l, "(foldl + scattered)")) == 1100000);
+		test(get_int(lisp_eval_string(l, "(foldl + kept)")) == 50005000);
+		state(lisp_gc_set_compact(l, 0));
+		state(lisp_gc_set_policy(l, 2.0, 1 << 24, 0));
+
+		state(lisp_destroy(l));
+	}
 	return unit_test_end("liblisp");	/*should be zero! */
 }
@@ -7,7 +7,7 @@
  *
  *  @todo    Grouped format specifiers should be treated as an "or", or they
  *           should be be treated as an "and", with the length being calculated
- *           correctly, which it is not.
+ *           correctly, which it is not. lisp_validate_compile() rejects them.
  *  @warning The number of arguments in the string and the number of arguments
  *           passed into the validation string must be the same, this is the
  *           responsibility of the user of these functions
@@ -21,34 +21,44 @@
 #include <assert.h>
 
 #define LISP_VALIDATE_ARGS_XLIST\
-        X('s', "symbol",            is_sym(x))\
-        X('d', "integer",           is_int(x))\
-        X('c', "cons",              is_cons(x))\
-        X('L', "cons-or-nil",       is_cons(x) || is_nil(x))\
-        X('p', "procedure",         is_proc(x))\
-        X('r', "subroutine",        is_subr(x))\
-        X('S', "string",            is_str(x))\
-        X('P', "io-port",           is_io(x))\
-        X('h', "hash",              is_hash(x))\
-        X('F', "f-expr",            is_fproc(x))\
-        X('f', "float",             is_floating(x))\
-        X('u', "user-defined",      is_userdef(x))\
-        X('b', "t-or-nil",          is_nil(x) || x == gsym_tee())\
-        X('i', "input-port",        is_in(x))\
-        X('o', "output-port",       is_out(x))\
-        X('Z', "symbol-or-string",  is_asciiz(x))\
-        X('M', "symbol-or-cons",    is_cons(x) || is_sym(x))\
-        X('a', "integer-or-float",  is_arith(x))\
-        X('x', "function",          is_func(x))\
-        X('I', "input-port-or-string", is_in(x) || is_str(x))\
-        X('l', "defined-procedure", is_proc(x) || is_fproc(x))\
-        X('C', "symbol-string-or-integer", is_asciiz(x) || is_int(x))\
-        X('A', "any-expression",    1)
+        X(SYMBOL,                    's', "symbol",            is_sym(x))\
+        X(INTEGER,                   'd', "integer",           is_int(x))\
+        X(CONS,                      'c', "cons",              is_cons(x))\
+        X(CONS_OR_NIL,               'L', "cons-or-nil",       is_cons(x) || is_nil(x))\
+        X(PROCEDURE,                 'p', "procedure",         is_proc(x))\
+        X(SUBROUTINE,                'r', "subroutine",        is_subr(x))\
+        X(STRING,                    'S', "string",            is_str(x))\
+        X(IO_PORT,                   'P', "io-port",           is_io(x))\
+        X(HASH,                      'h', "hash",              is_hash(x))\
+        X(F_EXPR,                    'F', "f-expr",            is_fproc(x))\
+        X(FLOAT,                     'f', "float",             is_floating(x))\
+        X(USER_DEFINED,              'u', "user-defined",      is_userdef(x))\
+        X(WEAK_REFERENCE,            'w', "weak-reference",    is_weak(x))\
+        X(T_OR_NIL,                  'b', "t-or-nil",          is_nil(x) || x == gsym_tee())\
+        X(INPUT_PORT,                'i', "input-port",        is_in(x))\
+        X(OUTPUT_PORT,               'o', "output-port",       is_out(x))\
+        X(SYMBOL_OR_STRING,          'Z', "symbol-or-string",  is_asciiz(x))\
+        X(SYMBOL_OR_CONS,            'M', "symbol-or-cons",    is_cons(x) || is_sym(x))\
+        X(INTEGER_OR_FLOAT,          'a', "integer-or-float",  is_arith(x))\
+        X(FUNCTION,                  'x', "function",          is_func(x))\
+        X(INPUT_PORT_OR_STRING,      'I', "input-port-or-string", is_in(x) || is_str(x))\
+        X(DEFINED_PROCEDURE,         'l', "defined-procedure", is_proc(x) || is_fproc(x))\
+        X(SYMBOL_STRING_OR_INTEGER,  'C', "symbol-string-or-integer", is_asciiz(x) || is_int(x))\
+        X(ANY_EXPRESSION,            'A', "any-expression",    1)
+
+/**@brief a code for each type a format string can check for*/
+typedef enum {
+#define X(NAME, CHAR, STRING, ACTION) VALID_ ## NAME,
+	LISP_VALIDATE_ARGS_XLIST
+#undef X
+} lisp_validate_code;
 
 static int print_type_string(lisp_t *l, const char *msg, unsigned len, const char *fmt, lisp_cell_t *args) {
         const char *s = NULL, *head = fmt;
         char c = 0;
         io_t *e = lisp_get_logging(l);
+        if (lisp_get_log_level(l) < LISP_LOG_LEVEL_ERROR)
+                return 0;
         msg = msg ? msg : "";
         lisp_printf(l, e, 0,
                 "\n(%Berror%t\n %y'validation\n %r\"%s\"\n%t '(%yexpected-length %r%d%t)\n '(%yexpected-arguments%t ",
@@ -57,7 +67,7 @@ static int print_type_string(lisp_t *l, const char *msg, unsigned len, const cha
                 s = "";
                 switch (c) {
                 case ' ': continue;
-#define X(CHAR, STRING, ACTION) case (CHAR): s = (STRING); break;
+#define X(NAME, CHAR, STRING, ACTION) case (CHAR): s = (STRING); break;
                 LISP_VALIDATE_ARGS_XLIST
 #undef X
                 default: LISP_RECOVER(l, "\"invalid format string\" \"%s\" %S))", head, args);
@@ -79,15 +89,74 @@ size_t lisp_validate_arg_count(const char *fmt) {
 	return i;
 }
 
+/**@brief does the argument "x" have the type "code" stands for?*/
+static inline int validate_code(unsigned code, lisp_cell_t * x) {
+	if (is_closed(x))
+		return 0;
+	switch (code) {
+#define X(NAME, CHAR, STRING, ACTION) case VALID_ ## NAME: return ACTION;
+	LISP_VALIDATE_ARGS_XLIST
+#undef X
+	}
+	return 0;
+}
+
+int lisp_validate_compile(const char *fmt, unsigned char *codes, size_t len) {
+	assert(fmt && codes);
+	size_t i = 0;
+	for (char c; (c = *fmt++) && i < len;) {
+		switch (c) {
+		case ' ':
+			continue;
+#define X(NAME, CHAR, STRING, ACTION) case (CHAR): codes[i++] = VALID_ ## NAME; break;
+		LISP_VALIDATE_ARGS_XLIST
+#undef X
+		default:
+			return -1;
+		}
+		if (*fmt && *fmt != ' ')
+			return -1; /*grouped specifiers are not supported*/
+	}
+	return i == len ? 0 : -1;
+}
+
+/**@brief report that the arguments of a primitive are invalid*/
+static int validate_fail(lisp_t * l, lisp_cell_t * x, lisp_cell_t * args, int recover) {
+	print_type_string(l, get_str(get_func_docstring(x)), get_length(x), get_func_format(x), args);
+	if (recover)
+		lisp_throw(l, 1);
+	return 0;
+}
+
 int lisp_validate_cell(lisp_t * l, lisp_cell_t * x, lisp_cell_t * args, int recover) {
 	assert(x && is_func(x));
-	lisp_cell_t *ds = get_func_docstring(x);
-	char *msg = get_str(ds);
-	msg = msg ? msg : "";
-	char *fmt = get_func_format(x);
-	if (!fmt)
+	const unsigned char *codes;
+	lisp_cell_t *head = args;
+	size_t i, len;
+	if (!get_func_format(x))
 		return 1;	/*as there is no validation string, its up to the function */
-	return lisp_validate_args(l, msg, get_length(x), fmt, args, recover);
+	codes = subr_codes(x);
+	len = get_length(x);
+	for (i = 0; i < len; i++, args = cdr(args))
+		if (!is_cons(args) || !validate_code(codes[i], car(args)))
+			return validate_fail(l, x, head, recover);
+	if (!is_nil(args))
+		return validate_fail(l, x, head, recover);
+	return 1;
+}
+
+int lisp_validate_vector(lisp_t * l, lisp_cell_t * x, size_t argc, lisp_cell_t ** argv, int recover) {
+	assert(l && x && is_func(x) && (argv || !argc));
+	const unsigned char *codes;
+	if (!get_func_format(x))
+		return 1;	/*as there is no validation string, its up to the function */
+	codes = subr_codes(x);
+	if (argc != get_length(x))
+		return validate_fail(l, x, lisp_args_list(l, argc, argv), recover);
+	for (size_t i = 0; i < argc; i++)
+		if (!validate_code(codes[i], argv[i]))
+			return validate_fail(l, x, lisp_args_list(l, argc, argv), recover);
+	return 1;
 }
 
 int lisp_validate_args(lisp_t * l, const char *msg, unsigned len, const char *fmt, lisp_cell_t * args, int recover) {
@@ -109,7 +178,7 @@ int lisp_validate_args(lisp_t * l, const char *msg, unsigned len, const char *fm
 		case ' ':
 			v = 1;
 			continue;
-#define X(CHAR, STRING, ACTION) case (CHAR): v = ACTION; break;
+#define X(NAME, CHAR, STRING, ACTION) case (CHAR): v = ACTION; break;
 			LISP_VALIDATE_ARGS_XLIST
 #undef X
 		default:
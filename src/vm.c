@@ -0,0 +1,455 @@
+/** @file       vm.c
+ *  @brief      A bytecode compiler and virtual machine for procedures
+ *  @author     Richard Howe (2015)
+ *  @license    LGPL v2.1 or Later
+ *  @email      howe.r.j.89@gmail.com
+ *
+ *  Procedures with their "bytecode" flag set, which "compile" sets on the
+ *  procedures it makes, are compiled the first time they are called into
+ *  an array of machine words kept in the procedure. Each instruction is an
+ *  opcode followed by its operands, which are numbers or cells taken from
+ *  the code of the procedure, so the procedure keeps them from being
+ *  collected. The virtual machine uses the garbage collection stack as its
+ *  value stack, so everything on it is reachable.
+ *
+ *  The results are the same as evaluating the procedure with eval(). The
+ *  special forms "if", "cond", "progn", "while", "quote", "setq", "define"
+ *  and "let", variables and procedure calls are compiled, anything else
+ *  (such as "lambda" or a malformed special form) is handed to eval().
+ *  Calls to "+", "-" and the other primitives lisp_arith() knows get their
+ *  own instruction, which does the arithmetic without calling the
+ *  primitive when it is still bound to the variable that was called.
+ **/
+#include "liblisp.h"
+#include "private.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/**@brief the instructions of the virtual machine, "x" is a cell operand,
+ *        "n" a number and "o" the offset of an instruction*/
+#define VM_OPCODE_XLIST\
+	X(VM_CONST)    /**< x:   push x*/\
+	X(VM_VARIABLE) /**< x:   push the value of the VARIABLE x*/\
+	X(VM_SYMBOL)   /**< x:   push the value of the symbol x*/\
+	X(VM_EVAL)     /**< x:   push the result of evaluating x*/\
+	X(VM_POP)      /**<      discard the top of the stack*/\
+	X(VM_JUMP)     /**< o:   jump to o*/\
+	X(VM_JUMP_NIL) /**< o:   pop the top of the stack and jump to o if it is nil*/\
+	X(VM_PROC)     /**< o x: check the procedure of call x, if it is an F-Expression call it and jump to o*/\
+	X(VM_CALL)     /**< n x: call a procedure with n arguments for call x*/\
+	X(VM_TAIL)     /**< n x: as VM_CALL, but the result is returned*/\
+	X(VM_ARITH)    /**< n x: as VM_CALL, but the arithmetic of a built in primitive is done inline*/\
+	X(VM_RETURN)   /**<      return the top of the stack*/\
+	X(VM_BINDING)  /**< x:   push the binding of a variable for "setq" x, and its field*/\
+	X(VM_SETQ)     /**<      set the binding under the top of the stack to it*/\
+	X(VM_DEFINE)   /**< x:   define the symbol x as the top of the stack*/\
+	X(VM_ENV)      /**<      push the environment*/\
+	X(VM_LET)      /**< x:   bind x to nil in a new FRAME*/\
+	X(VM_LET_SET)  /**<      pop the top of the stack into the binding of the last VM_LET*/\
+	X(VM_RESTORE)  /**<      restore the environment pushed under the top of the stack*/
+
+#define X(OPCODE) OPCODE,
+enum vm_opcode { VM_OPCODE_XLIST VM_OPCODE_LAST };
+#undef X
+
+/**@brief a procedure being compiled, the first word of the code is the
+ *        number of words in it*/
+typedef struct {
+	lisp_t *l;
+	uintptr_t *code;  /**< instructions compiled so far*/
+	size_t used,      /**< words of "code" in use*/
+	       allocated; /**< words allocated for "code"*/
+} vm_compiler_t;
+
+static void vm_emit(vm_compiler_t *c, uintptr_t w) {
+	assert(c);
+	if (c->used >= c->allocated) {
+		size_t n = c->allocated ? c->allocated * 2 : SMALL_DEFAULT_LEN;
+		uintptr_t *code = n > c->allocated ? realloc(c->code, n * sizeof(*code)) : NULL;
+		if (!code) {
+			free(c->code);
+			lisp_out_of_memory(c->l);
+		}
+		c->code = code;
+		c->allocated = n;
+	}
+	c->code[c->used++] = w;
+}
+
+static void vm_emit_cell(vm_compiler_t *c, enum vm_opcode op, lisp_cell_t *x) {
+	vm_emit(c, op);
+	vm_emit(c, (uintptr_t)x);
+}
+
+/**@brief emit an instruction with a jump offset that is not known yet,
+ *	  jumps to the same place are chained together through their
+ *	  operands, see vm_patch()
+ * @return the new head of the chain*/
+static size_t vm_emit_jump(vm_compiler_t *c, enum vm_opcode op, size_t chain) {
+	vm_emit(c, op);
+	vm_emit(c, chain);
+	return c->used - 1;
+}
+
+/**@brief point a chain of jumps made by vm_emit_jump() at the next
+ *	  instruction*/
+static void vm_patch(vm_compiler_t *c, size_t chain) {
+	while (chain) {
+		size_t next = c->code[chain];
+		c->code[chain] = c->used;
+		chain = next;
+	}
+}
+
+static void vm_compile(vm_compiler_t *c, unsigned depth, lisp_cell_t *exp, int tail);
+
+/**@brief is the procedure of a call, "f", a top level variable bound to
+ *	  a primitive lisp_arith() can do the arithmetic of, with "n"
+ *	  arguments?*/
+static int vm_arith(lisp_cell_t *f, size_t n) {
+	lisp_cell_t *x;
+	if (n != 2 || cell_type(f) != VARIABLE || variable_depth(f) != VARIABLE_GLOBAL)
+		return 0;
+	if (is_nil(variable_binding(f)))
+		return 0;
+	x = cdr(variable_binding(f));
+	return is_subr(x) && x->arith != ARITH_NONE;
+}
+
+/**@brief compile a list of expressions, as "progn" evaluates them*/
+static void vm_compile_body(vm_compiler_t *c, unsigned depth, lisp_cell_t *exps, int tail) {
+	if (is_nil(exps)) {
+		vm_emit_cell(c, VM_CONST, c->l->nil);
+		return;
+	}
+	for (; !is_nil(cdr(exps)); exps = cdr(exps)) {
+		vm_compile(c, depth, car(exps), 0);
+		vm_emit(c, VM_POP);
+	}
+	vm_compile(c, depth, car(exps), tail);
+}
+
+/**@brief can "cond" with the clauses "exp" be compiled, the clauses eval()
+ *	  does not stop at must have a test and an expression*/
+static int vm_cond_ok(lisp_cell_t *exp) {
+	for (; is_cons(exp); exp = cdr(exp))
+		if (!is_cons(car(exp)))
+			return 1;
+		else if (get_length(car(exp)) < 2)
+			return 0;
+	return 1;
+}
+
+/**@brief can "let" with the arguments "exp" be compiled?*/
+static int vm_let_ok(lisp_cell_t *exp) {
+	if (get_length(exp) < 2)
+		return 0;
+	for (; !is_nil(cdr(exp)); exp = cdr(exp))
+		if (!is_cons(car(exp)) || !lisp_check_length(car(exp), 2))
+			return 0;
+	return 1;
+}
+
+/**@brief compile an expression so that its value is pushed, unless it
+ *	  is in the tail position and is a call, then the call replaces
+ *	  the current one*/
+static void vm_compile(vm_compiler_t *c, unsigned depth, lisp_cell_t *exp, int tail) {
+	lisp_t *l = c->l;
+	lisp_cell_t *first, *args;
+	size_t chain = 0, skip;
+	if (is_nil(exp) || (cell_type(exp) != SYMBOL && cell_type(exp) != VARIABLE && cell_type(exp) != CONS)) {
+		vm_emit_cell(c, VM_CONST, exp);
+		return;
+	}
+	if (is_sym(exp)) {
+		vm_emit_cell(c, VM_SYMBOL, exp);
+		return;
+	}
+	if (cell_type(exp) == VARIABLE) {
+		vm_emit_cell(c, VM_VARIABLE, exp);
+		return;
+	}
+	first = car(exp);
+	args = cdr(exp);
+	if (depth > MAX_RECURSION_DEPTH || is_cons(first) || (!is_nil(args) && !is_proper_cons(args)))
+		goto eval;
+	if (first == l->quote) {
+		if (!is_cons(args))
+			goto eval;
+		vm_emit_cell(c, VM_CONST, car(args));
+		return;
+	}
+	if (first == l->iif) {
+		if (!lisp_check_length(args, 3))
+			goto eval;
+		vm_compile(c, depth + 1, car(args), 0);
+		skip = vm_emit_jump(c, VM_JUMP_NIL, 0);
+		vm_compile(c, depth + 1, CADR(args), tail);
+		chain = vm_emit_jump(c, VM_JUMP, 0);
+		vm_patch(c, skip);
+		vm_compile(c, depth + 1, CADDR(args), tail);
+		vm_patch(c, chain);
+		return;
+	}
+	if (first == l->progn) {
+		vm_compile_body(c, depth + 1, args, tail);
+		return;
+	}
+	if (first == l->cond) {
+		if (!vm_cond_ok(args))
+			goto eval;
+		for (; is_cons(args); args = cdr(args)) {
+			if (!is_cons(car(args)))
+				break; /*eval() returns nil here*/
+			vm_compile(c, depth + 1, CAAR(args), 0);
+			skip = vm_emit_jump(c, VM_JUMP_NIL, 0);
+			vm_compile(c, depth + 1, CADAR(args), tail);
+			chain = vm_emit_jump(c, VM_JUMP, chain);
+			vm_patch(c, skip);
+		}
+		vm_emit_cell(c, VM_CONST, l->nil);
+		vm_patch(c, chain);
+		return;
+	}
+	if (first == l->dowhile) {
+		size_t top = c->used;
+		if (!is_cons(args))
+			goto eval;
+		vm_compile(c, depth + 1, car(args), 0);
+		skip = vm_emit_jump(c, VM_JUMP_NIL, 0);
+		for (args = cdr(args); is_cons(args); args = cdr(args)) {
+			vm_compile(c, depth + 1, car(args), 0);
+			vm_emit(c, VM_POP);
+		}
+		vm_emit(c, VM_JUMP);
+		vm_emit(c, top);
+		vm_patch(c, skip);
+		vm_emit_cell(c, VM_CONST, l->nil);
+		return;
+	}
+	if (first == l->setq) {
+		if (!lisp_check_length(args, 2) || !is_sym(car(args)))
+			goto eval;
+		vm_emit_cell(c, VM_BINDING, args);
+		vm_compile(c, depth + 1, CADR(args), 0);
+		vm_emit(c, VM_SETQ);
+		return;
+	}
+	if (first == l->define) {
+		if (!lisp_check_length(args, 2) || !is_sym(car(args)))
+			goto eval;
+		vm_compile(c, depth + 1, CADR(args), 0);
+		vm_emit_cell(c, VM_DEFINE, car(args));
+		return;
+	}
+	if (first == l->let) {
+		if (!vm_let_ok(args))
+			goto eval;
+		vm_emit(c, VM_ENV);
+		for (; !is_nil(cdr(args)); args = cdr(args)) {
+			vm_emit_cell(c, VM_LET, CAAR(args));
+			vm_compile(c, depth + 1, CADAR(args), 0);
+			vm_emit(c, VM_LET_SET);
+		}
+		vm_compile(c, depth + 1, car(args), 0);
+		vm_emit(c, VM_RESTORE);
+		return;
+	}
+	if (lisp_is_special(l, first))
+		goto eval;
+	vm_compile(c, depth + 1, first, 0);
+	skip = vm_emit_jump(c, VM_PROC, 0);
+	vm_emit(c, (uintptr_t)exp);
+	for (; is_cons(args); args = cdr(args))
+		vm_compile(c, depth + 1, car(args), 0);
+	if (vm_arith(first, get_length(cdr(exp))))
+		vm_emit(c, VM_ARITH);
+	else
+		vm_emit(c, tail ? VM_TAIL : VM_CALL);
+	vm_emit(c, get_length(cdr(exp)));
+	vm_emit(c, (uintptr_t)exp);
+	vm_patch(c, skip);
+	return;
+eval:
+	vm_emit_cell(c, VM_EVAL, exp);
+}
+
+/**@brief get the bytecode of a procedure, compiling it if needed*/
+static uintptr_t *vm_code(lisp_t *l, lisp_cell_t *proc) {
+	assert(l && is_proc(proc));
+	vm_compiler_t c = { l, NULL, 0, 0 };
+	if (proc->p[3].v)
+		return proc->p[3].v;
+	vm_emit(&c, 0);
+	vm_compile_body(&c, 0, get_proc_code(proc), 1);
+	vm_emit(&c, VM_RETURN);
+	c.code[0] = c.used;
+	proc->p[3].v = c.code; /*owned by the procedure before the quota is checked*/
+	lisp_gc_reserve(l, c.used * sizeof(*c.code));
+	l->gc_owned += c.used * sizeof(*c.code);
+	return c.code;
+}
+
+void lisp_set_bytecode(lisp_cell_t *x, int on) {
+	assert(x && is_proc(x));
+	x->bytecode = !!on;
+}
+
+/* The stack of the virtual machine is the part of the garbage collection
+ * stack above "base", the procedure and environment are kept at the bottom
+ * of it. Anything allocated is put on the garbage collection stack above
+ * "sp", so "l->gc_stack_used" is set back to "sp" before a value is pushed.*/
+#define VM_PUSH(X)   do { lisp_cell_t *x_ = (X); l->gc_stack_used = sp++; lisp_gc_add(l, x_); } while (0)
+#define VM_TOP       (l->gc_stack[sp - 1])
+#define VM_SIGNAL()  do { if (l->sig) { l->sig = 0; lisp_throw(l, 1); } } while (0)
+
+lisp_cell_t *lisp_vm_run(lisp_t *l, unsigned depth, lisp_cell_t *proc, lisp_cell_t *env) {
+	assert(l && proc && env);
+	const size_t base = l->gc_stack_used;
+	size_t sp, pc;
+	uintptr_t *code;
+	lisp_cell_t *x, *f, *vals;
+	size_t slot;
+	if (depth > MAX_RECURSION_DEPTH)
+		LISP_RECOVER(l, "%y'recursion-depth-reached%t %d", (intptr_t)depth);
+	lisp_gc_add(l, proc);
+	lisp_gc_add(l, env);
+start:
+	VM_SIGNAL();
+	l->gc_stack[base] = proc;
+	l->gc_stack[base + 1] = env;
+	sp = base + 2;
+	code = vm_code(l, proc);
+	for (pc = 1;;) {
+		switch (code[pc++]) {
+		case VM_CONST:
+			VM_PUSH((lisp_cell_t *)code[pc++]);
+			break;
+		case VM_VARIABLE:
+			x = (lisp_cell_t *)code[pc++];
+			if (is_nil(f = lisp_variable_lookup(l, x, env, &slot)))
+				LISP_RECOVER(l, "%r\"unbound symbol\"\n %y'%s%t", get_sym(variable_symbol(x)));
+			VM_PUSH(binding_value(f, slot));
+			break;
+		case VM_SYMBOL:
+			x = (lisp_cell_t *)code[pc++];
+			if (is_nil(f = lisp_env_lookup(x, env, &slot)))
+				LISP_RECOVER(l, "%r\"unbound symbol\"\n %y'%s%t", get_sym(x));
+			VM_PUSH(binding_value(f, slot));
+			break;
+		case VM_EVAL:
+			l->gc_stack_used = sp;
+			VM_PUSH(eval(l, depth + 1, (lisp_cell_t *)code[pc++], env));
+			break;
+		case VM_POP:
+			sp--;
+			break;
+		case VM_JUMP:
+			if (code[pc] < pc)
+				VM_SIGNAL();
+			pc = code[pc];
+			break;
+		case VM_JUMP_NIL:
+			pc = is_nil(l->gc_stack[--sp]) ? code[pc] : pc + 1;
+			break;
+		case VM_PROC:
+			f = VM_TOP;
+			x = (lisp_cell_t *)code[pc + 1];
+			if (is_proc(f) || is_subr(f)) {
+				pc += 2;
+				break;
+			}
+			if (!is_fproc(f))
+				LISP_RECOVER(l, "%r\"not a procedure\"%t\n '%S", car(x));
+			l->gc_stack_used = sp;
+			l->cur_depth = depth;
+			l->cur_env = env;
+			vals = lisp_function_args(l, f, cons(l, cdr(x), l->nil));
+			x = lisp_eval_body(l, depth + 1, get_proc_code(f), vals);
+			sp--;
+			VM_PUSH(x);
+			pc = code[pc];
+			break;
+		case VM_ARITH:
+			x = lisp_arith(l, l->gc_stack[sp - 3], l->gc_stack[sp - 2], VM_TOP);
+			if (x) {
+				pc += 2;
+				sp -= 3;
+				VM_PUSH(x);
+				break;
+			}
+			/* fall through */
+		case VM_CALL:
+		case VM_TAIL:
+		{
+			const int tail = code[pc - 1] == VM_TAIL;
+			const size_t n = code[pc];
+			pc += 2;
+			l->gc_stack_used = sp;
+			f = l->gc_stack[sp - n - 1];
+			l->cur_depth = depth;
+			l->cur_env = env;
+			if (is_subr(f)) {
+				x = lisp_subr_call(l, f, sp - n, n);
+			} else { /*the arguments are bound from the stack*/
+				vals = lisp_function_frame(l, f, sp - n, n);
+				if (tail && f->bytecode) {
+					proc = f;
+					env = vals;
+					goto start;
+				}
+				if (f->bytecode)
+					x = lisp_vm_run(l, depth + 1, f, vals);
+				else
+					x = lisp_eval_body(l, depth + 1, get_proc_code(f), vals);
+			}
+			sp -= n + 1;
+			VM_PUSH(x);
+			break;
+		}
+		case VM_RETURN:
+			x = VM_TOP;
+			l->gc_stack_used = base;
+			return lisp_gc_add(l, x);
+		case VM_BINDING:
+			x = (lisp_cell_t *)code[pc++];
+			if (is_nil(f = lisp_env_lookup(car(x), env, &slot)))
+				LISP_RECOVER(l, "%y'setq\n %r\"undefined variable\"%t\n '%S", x);
+			VM_PUSH(f);
+			VM_PUSH(mk_int(l, slot));
+			break;
+		case VM_SETQ:
+			x = l->gc_stack[--sp];
+			slot = get_int(l->gc_stack[--sp]);
+			lisp_binding_set(VM_TOP, slot, x);
+			VM_TOP = x;
+			break;
+		case VM_DEFINE:
+			lisp_extend_top(l, (lisp_cell_t *)code[pc++], VM_TOP);
+			break;
+		case VM_ENV:
+			VM_PUSH(env);
+			break;
+		case VM_LET:
+			l->gc_stack_used = sp;
+			env = lisp_extend_frame(l, env, (lisp_cell_t *)code[pc++]);
+			l->gc_stack[base + 1] = env;
+			break;
+		case VM_LET_SET:
+			lisp_binding_set(env, FRAME_VALUES, l->gc_stack[--sp]);
+			break;
+		case VM_RESTORE:
+			x = l->gc_stack[--sp];
+			env = VM_TOP;
+			l->gc_stack[base + 1] = env;
+			VM_TOP = x;
+			break;
+		default:
+			FATAL("internal inconsistency: unknown opcode");
+		}
+	}
+}
+
+#undef VM_PUSH
+#undef VM_TOP
+#undef VM_SIGNAL